@@ -0,0 +1,113 @@
+/*
+  This program queries the HLK-LD2410 presence sensor
+  without blocking the main loop. The commands are
+  enqueued as queue slots become free, and transmitted
+  one at a time by sensor.check(), while the loop keeps running.
+
+  #define SERIAL_BAUD_RATE sets the serial monitor baud rate
+
+  Communication with the sensor is handled by the 
+  "MyLD2410" library Copyright (c) Iavor Veltchev 2024
+
+  Use only hardware UART at the default baud rate 256000,
+  or change the #define LD2410_BAUD_RATE to match your sensor.
+  For ESP32 or other boards that allow dynamic UART pins,
+  modify the RX_PIN and TX_PIN defines
+
+  Connection diagram:
+  Arduino/ESP32 RX  -- TX LD2410 
+  Arduino/ESP32 TX  -- RX LD2410
+  Arduino/ESP32 GND -- GND LD2410
+  Provide sufficient power to the sensor Vcc (200mA, 5-12V) 
+*/
+
+#if defined(ARDUINO_SAMD_NANO_33_IOT) || defined(ARDUINO_AVR_LEONARDO)
+//ARDUINO_SAMD_NANO_33_IOT RX_PIN is D1, TX_PIN is D0 
+//ARDUINO_AVR_LEONARDO RX_PIN(RXI) is D0, TX_PIN(TXO) is D1 
+#define sensorSerial Serial1
+#elif defined(ARDUINO_XIAO_ESP32C3) || defined(ARDUINO_XIAO_ESP32C6)
+//RX_PIN is D7, TX_PIN is D6
+#define sensorSerial Serial0
+#elif defined(ESP32)
+//Other ESP32 device - choose available GPIO pins
+#define sensorSerial Serial1
+#if defined(ARDUINO_ESP32S3_DEV)
+#define RX_PIN 18
+#define TX_PIN 17
+#else
+#define RX_PIN 16
+#define TX_PIN 17
+#endif
+#else
+#error "This sketch only works on ESP32, Arduino Nano 33IoT, and Arduino Leonardo (Pro-Micro)"
+#endif
+
+// User defines
+#define SERIAL_BAUD_RATE 115200
+
+//Change the communication baud rate here, if necessary
+//#define LD2410_BAUD_RATE 256000
+#include "MyLD2410.h"
+
+MyLD2410 sensor(sensorSerial);
+
+// The range in cm also needs the resolution: query it too, so that getRange_cm() uses cached values
+const MyLD2410::Command commands[]{
+  MyLD2410::CMD_CONFIG_ON,
+  MyLD2410::CMD_MAC,
+  MyLD2410::CMD_PARAMETERS,
+  MyLD2410::CMD_RESOLUTION,
+  MyLD2410::CMD_CONFIG_OFF
+};
+const byte commandCount = sizeof(commands) / sizeof(commands[0]);
+byte nextCommand = 0;
+unsigned int resolutionHandle = 0;
+unsigned long loops = 0;
+
+void onCommand(unsigned int handle, unsigned int command, MyLD2410::CommandStatus status) {
+  Serial.print("Command 0x");
+  Serial.print(command, HEX);
+  Serial.println((status == MyLD2410::COMMAND_DONE) ? " done" : " failed");
+}
+
+// The queue holds LD2410_COMMAND_QUEUE commands (4 on AVR):
+// enqueueCommand() returns 0 when it is full, so retry on the next loop
+void enqueueCommands() {
+  while (nextCommand < commandCount) {
+    unsigned int handle = sensor.enqueueCommand(commands[nextCommand], onCommand);
+    if (!handle) return;
+    if (commands[nextCommand] == MyLD2410::CMD_RESOLUTION) resolutionHandle = handle;
+    nextCommand++;
+  }
+}
+
+void setup() {
+  Serial.begin(SERIAL_BAUD_RATE);
+#if defined(ARDUINO_XIAO_ESP32C3) || defined(ARDUINO_XIAO_ESP32C6) || defined(ARDUINO_SAMD_NANO_33_IOT) || defined(ARDUINO_AVR_LEONARDO)
+  sensorSerial.begin(LD2410_BAUD_RATE);
+#else
+  sensorSerial.begin(LD2410_BAUD_RATE, SERIAL_8N1, RX_PIN, TX_PIN);
+#endif
+  delay(2000);
+  Serial.println(__FILE__);
+  if (!sensor.begin()) {
+    Serial.println("Failed to communicate with the sensor.");
+    while (true) {}
+  }
+  enqueueCommands();
+}
+
+void loop() {
+  sensor.check();
+  enqueueCommands();
+  loops++;
+  if (resolutionHandle && (sensor.commandStatus(resolutionHandle) == MyLD2410::COMMAND_DONE)) {
+    resolutionHandle = 0;
+    Serial.print("MAC: ");
+    Serial.println(sensor.getMACstr());
+    Serial.print("Max range: ");
+    Serial.print(sensor.getRange_cm());
+    Serial.print("cm, loop iterations so far: ");
+    Serial.println(loops);
+  }
+}
@@ -0,0 +1,126 @@
+/*
+  Minimal host-side stand-in for the Arduino core, just enough to compile
+  MyLD2410 with a desktop compiler for the benchmark. Not used on target.
+*/
+#ifndef LD2410_BENCH_ARDUINO_H
+#define LD2410_BENCH_ARDUINO_H
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+typedef uint8_t byte;
+typedef uint16_t word;
+
+#define HEX 16
+#define DEC 10
+#define PROGMEM
+#define memcpy_P memcpy
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+inline void yield() {}
+
+// No pins on the host: the pin and interrupt functions do nothing
+#define INPUT 0
+#define LOW 0
+#define HIGH 1
+#define CHANGE 1
+#define digitalPinToInterrupt(pin) (pin)
+inline void pinMode(int, int) {}
+inline int digitalRead(int) { return LOW; }
+inline void attachInterrupt(int, void (*)(), int) {}
+inline void detachInterrupt(int) {}
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+class String
+{
+  std::string s;
+
+public:
+  String(const char *c = "") : s(c) {}
+  unsigned int length() const { return s.size(); }
+  const char *c_str() const { return s.c_str(); }
+  char operator[](unsigned int i) const { return s[i]; }
+};
+
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t b) = 0;
+  virtual size_t write(const uint8_t *buf, size_t size)
+  {
+    size_t n = 0;
+    while (size--)
+      n += write(*buf++);
+    return n;
+  }
+  size_t write(const char *str) { return write((const uint8_t *)str, strlen(str)); }
+  virtual void flush() {}
+  size_t print(const char *str) { return write(str); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(unsigned long v, int base = DEC)
+  {
+    char b[24];
+    snprintf(b, sizeof(b), (base == HEX) ? "%lx" : "%lu", v);
+    return write(b);
+  }
+  size_t print(long v)
+  {
+    char b[24];
+    snprintf(b, sizeof(b), "%ld", v);
+    return write(b);
+  }
+  size_t print(int v) { return print((long)v); }
+  size_t print(unsigned int v) { return print((unsigned long)v); }
+  size_t print(unsigned char v) { return print((unsigned long)v); }
+  size_t println() { return write("\r\n"); }
+  template <typename T>
+  size_t println(T v) { return print(v) + println(); }
+};
+
+class Stream : public Print
+{
+protected:
+  unsigned long _timeout = 1000;
+
+public:
+  using Print::write;
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  void setTimeout(unsigned long timeout) { _timeout = timeout; }
+  virtual size_t readBytes(uint8_t *buf, size_t size)
+  {
+    size_t n = 0;
+    while (n < size)
+    {
+      int b = read();
+      if (b < 0)
+        break;
+      buf[n++] = (uint8_t)b;
+    }
+    return n;
+  }
+  size_t readBytes(char *buf, size_t size) { return readBytes((uint8_t *)buf, size); }
+};
+
+class HostSerial : public Stream
+{
+public:
+  using Print::write;
+  size_t write(uint8_t b) override { return fwrite(&b, 1, 1, stdout); }
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  void begin(unsigned long) {}
+};
+
+extern HostSerial Serial;
+
+#endif // LD2410_BENCH_ARDUINO_H
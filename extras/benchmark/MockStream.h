@@ -0,0 +1,157 @@
+/*
+  A simulated LD2410 serial stream for the host benchmark and checks.
+  The stream replays a prepared script of bytes, either as fast as
+  the parser can consume them or at a fixed byte rate (baud / 10).
+*/
+#ifndef LD2410_MOCK_STREAM_H
+#define LD2410_MOCK_STREAM_H
+#include "Arduino.h"
+#include <vector>
+
+class MockStream : public Stream
+{
+  std::vector<uint8_t> script;
+  size_t pos = 0;
+  unsigned long bytesPerSecond = 0;
+  unsigned long startedAt = 0;
+  size_t burst = 0;
+  uint32_t seed = 1;
+
+  // Bytes that have "arrived" so far
+  size_t arrived()
+  {
+    size_t n = script.size();
+    if (bytesPerSecond)
+    {
+      unsigned long long due = (unsigned long long)(micros() - startedAt) * bytesPerSecond / 1000000UL;
+      if (due < n)
+        n = due;
+    }
+    // With a burst size, the bytes show up a few at a time, one burst per available() or readBytes()
+    if (burst && (n > pos + burst))
+      n = pos + burst;
+    return n;
+  }
+
+  void frame(bool ack, const std::vector<uint8_t> &body)
+  {
+    static const uint8_t headData[4]{0xF4, 0xF3, 0xF2, 0xF1};
+    static const uint8_t tailData[4]{0xF8, 0xF7, 0xF6, 0xF5};
+    static const uint8_t headConfig[4]{0xFD, 0xFC, 0xFB, 0xFA};
+    static const uint8_t tailConfig[4]{4, 3, 2, 1};
+    script.insert(script.end(), ack ? headConfig : headData, (ack ? headConfig : headData) + 4);
+    script.push_back(body.size() & 0xFF);
+    script.push_back(body.size() >> 8);
+    script.insert(script.end(), body.begin(), body.end());
+    script.insert(script.end(), ack ? tailConfig : tailData, (ack ? tailConfig : tailData) + 4);
+  }
+
+public:
+  using Print::write;
+
+  uint32_t random()
+  {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+  }
+
+  // SCRIPT
+
+  void clear()
+  {
+    script.clear();
+    rewind();
+  }
+
+  // A data frame, basic or enhanced, with pseudo-random content
+  void data(bool enhanced)
+  {
+    uint16_t moving = random() % 600, stationary = random() % 600;
+    std::vector<uint8_t> body{
+        uint8_t(enhanced ? 1 : 2), 0xAA, uint8_t(random() % 4),
+        uint8_t(moving), uint8_t(moving >> 8), uint8_t(random() % 100),
+        uint8_t(stationary), uint8_t(stationary >> 8), uint8_t(random() % 100),
+        uint8_t(moving), uint8_t(moving >> 8)};
+    if (enhanced)
+    {
+      body.push_back(8);
+      body.push_back(8);
+      for (int i = 0; i < 18; i++)
+        body.push_back(random() % 100);
+      body.push_back(random() % 256);
+      body.push_back(random() & 1);
+    }
+    body.push_back(0x55);
+    body.push_back(0);
+    frame(false, body);
+  }
+
+  // An ACK for the parameter read (0x61), the longest configuration reply
+  void ackParameters()
+  {
+    std::vector<uint8_t> body{0x61, 1, 0, 0, 0xAA, 8, 8, 8};
+    for (int i = 0; i < 18; i++)
+      body.push_back(random() % 100);
+    body.push_back(5);
+    body.push_back(0);
+    frame(true, body);
+  }
+
+  // Random bytes between frames
+  void noise(size_t n)
+  {
+    while (n--)
+      script.push_back(random() & 0xFF);
+  }
+
+  // Cut the last frame short after n bytes
+  void truncate(size_t n)
+  {
+    size_t start = script.size();
+    data(true);
+    script.resize(start + n);
+  }
+
+  size_t size() const { return script.size(); }
+  const uint8_t *bytes() const { return script.data(); }
+
+  // PLAYBACK
+
+  // 0 replays as fast as the reader consumes, otherwise at baud / 10 bytes per second
+  void setBaud(unsigned long baud) { bytesPerSecond = baud / 10; }
+
+  // 0 delivers everything that has arrived, otherwise at most n bytes per call
+  void setBurst(size_t n) { burst = n; }
+
+  void rewind()
+  {
+    pos = 0;
+    startedAt = micros();
+  }
+
+  bool done() const { return pos >= script.size(); }
+
+  int available() override { return arrived() - pos; }
+
+  int read() override { return (pos < arrived()) ? script[pos++] : -1; }
+
+  int peek() override { return (pos < arrived()) ? script[pos] : -1; }
+
+  size_t readBytes(uint8_t *buf, size_t size) override
+  {
+    size_t n = arrived() - pos;
+    if (n > size)
+      n = size;
+    memcpy(buf, script.data() + pos, n);
+    pos += n;
+    return n;
+  }
+
+  // Commands from the driver are discarded
+  size_t write(uint8_t) override { return 1; }
+  size_t write(const uint8_t *, size_t size) override { return size; }
+};
+
+#endif // LD2410_MOCK_STREAM_H
@@ -0,0 +1,216 @@
+/*
+  Host-side benchmark of the MyLD2410 parsing path.
+
+  Build and run from the repository root with a desktop compiler:
+    g++ -O2 -std=c++11 -Iextras/benchmark -Isrc extras/benchmark/benchmark.cpp src/MyLD2410.cpp -o ld2410_bench
+    ./ld2410_bench [frames per scenario] [baud]
+
+  Without a baud rate the frames are replayed as fast as check() consumes them,
+  which measures throughput (frames/s, ns per byte). With a baud rate (e.g. 256000)
+  the bytes trickle in as on a real UART, which measures the cost of each check() call;
+  most calls then find an empty stream, so ns/byte and process are only shown at full speed.
+  The "basic" and "enhanced" scenarios exercise processData(), "ack" exercises processAck().
+
+  The stages are timed apart, per frame:
+    sync    - LD2410Core::Parser alone: hunting, length and tail checks
+    decode  - LD2410Core::decodeData() alone, data frames only
+    process - check() minus sync: processData() or processAck() and the driver overhead
+*/
+#include "Arduino.h"
+#include "MockStream.h"
+#include "MyLD2410.h"
+#include <chrono>
+#include <thread>
+
+HostSerial Serial;
+
+static const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+
+unsigned long millis()
+{
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count();
+}
+
+unsigned long micros()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+}
+
+void delay(unsigned long ms)
+{
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+enum Scenario
+{
+  BASIC,
+  ENHANCED,
+  ACK,
+  MIXED,
+  NOISY
+};
+
+static const char *scenarioName[]{"basic", "enhanced", "ack", "mixed", "noisy"};
+
+// Prepare the script, return the number of complete frames in it
+static unsigned long build(MockStream &stream, Scenario scenario, unsigned long frames)
+{
+  unsigned long complete = 0;
+  stream.clear();
+  for (unsigned long i = 0; i < frames; i++)
+  {
+    switch (scenario)
+    {
+    case BASIC:
+      stream.data(false);
+      break;
+    case ENHANCED:
+      stream.data(true);
+      break;
+    case ACK:
+      stream.ackParameters();
+      break;
+    case MIXED:
+      // An interleaved ACK after every 4 data frames
+      if ((i % 5) == 4)
+        stream.ackParameters();
+      else
+        stream.data(true);
+      break;
+    case NOISY:
+      // Noise bursts between frames and every 8th frame truncated
+      stream.noise(stream.random() % 8);
+      if ((i % 8) == 7)
+      {
+        stream.truncate(1 + stream.random() % 40);
+        continue;
+      }
+      stream.data(true);
+      break;
+    }
+    complete++;
+  }
+  return complete;
+}
+
+// The stages without the driver, on the whole script at once
+struct Stages
+{
+  double sync;   // [ns] the parser per frame
+  double decode; // [ns] decodeData() per data frame, 0 without data frames
+};
+
+static volatile unsigned long sink;
+
+static Stages stages(const MockStream &stream)
+{
+  std::vector<std::vector<uint8_t>> payloads;
+  Stages result{0, 0};
+  unsigned long found = 0;
+  std::chrono::nanoseconds elapsed(0);
+  // Warm up once, then measure the second pass
+  for (int pass = 0; pass < 2; pass++)
+  {
+    LD2410Core::Parser<LD2410_BUFFER_SIZE> parser;
+    const uint8_t *p = stream.bytes();
+    size_t n = stream.size();
+    found = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while (n || parser.pending())
+    {
+      LD2410Core::FrameType type;
+      size_t step = (n < LD2410_RX_CHUNK) ? n : LD2410_RX_CHUNK;
+      size_t used = parser.feed(p, step, type);
+      p += used;
+      n -= used;
+      if (type == LD2410Core::NONE)
+        continue;
+      found++;
+      if (!pass && (type == LD2410Core::DATA))
+        payloads.emplace_back(parser.payload(), parser.payload() + parser.payloadSize());
+    }
+    elapsed = std::chrono::steady_clock::now() - start;
+  }
+  if (found)
+    result.sync = double(elapsed.count()) / found;
+  if (payloads.empty())
+    return result;
+  MyLD2410::SensorData record{};
+  unsigned long decoded = 0, sum = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int pass = 0; pass < 2; pass++)
+    for (const std::vector<uint8_t> &payload : payloads)
+    {
+      decoded += LD2410Core::decodeData(payload.data(), record);
+      // Use the record, or the compiler drops the decoding
+      sum += record.distance + record.mTargetSignals.values[record.mTargetSignals.N] + record.sTargetSignals.N;
+    }
+  elapsed = std::chrono::steady_clock::now() - start;
+  sink = sum;
+  if (decoded)
+    result.decode = double(elapsed.count()) / decoded;
+  return result;
+}
+
+static void run(Scenario scenario, unsigned long frames, unsigned long baud)
+{
+  MockStream stream;
+  unsigned long complete = build(stream, scenario, frames);
+  stream.setBaud(baud);
+  MyLD2410 sensor(stream);
+  unsigned long parsed = 0, calls = 0;
+  std::chrono::nanoseconds busy(0), worst(0), wall(0);
+  // Warm up once, then measure the second pass
+  for (int pass = 0; pass < 2; pass++)
+  {
+    parsed = calls = 0;
+    busy = worst = std::chrono::nanoseconds(0);
+    stream.rewind();
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    while (!stream.done())
+    {
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      MyLD2410::Response response = sensor.check();
+      std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+      busy += elapsed;
+      if (elapsed > worst)
+        worst = elapsed;
+      calls++;
+      if (response != MyLD2410::FAIL)
+        parsed++;
+    }
+    wall = std::chrono::steady_clock::now() - begin;
+  }
+  Stages stage = stages(stream);
+  // At a fixed baud rate the frame rate is bounded by the line, not by check()
+  double ns = busy.count(), period = (baud) ? wall.count() : ns;
+  printf("%-9s %9lu %9lu %12.0f ", scenarioName[scenario], complete, parsed, (period > 0) ? parsed * 1e9 / period : 0.0);
+  if (baud)
+    printf("%10s ", "-");
+  else
+    printf("%10.2f ", ns / stream.size());
+  printf("%10.0f %10lld %8.0f ", ns / calls, (long long)worst.count(), stage.sync);
+  if (stage.decode > 0)
+    printf("%8.0f ", stage.decode);
+  else
+    printf("%8s ", "-");
+  if (!baud && parsed)
+    printf("%8.0f\n", ns / parsed - stage.sync);
+  else
+    printf("%8s\n", "-");
+}
+
+int main(int argc, char **argv)
+{
+  unsigned long frames = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 20000;
+  unsigned long baud = (argc > 2) ? strtoul(argv[2], nullptr, 10) : 0;
+  if (baud)
+    printf("Replaying %lu frames per scenario at %lu baud\n", frames, baud);
+  else
+    printf("Replaying %lu frames per scenario at full speed\n", frames);
+  printf("%-9s %9s %9s %12s %10s %10s %10s %8s %8s %8s\n", "scenario", "frames", "parsed", "frames/s",
+         "ns/byte", "ns/check", "worst ns", "sync", "decode", "process");
+  for (int s = BASIC; s <= NOISY; s++)
+    run(Scenario(s), frames, baud);
+  return 0;
+}
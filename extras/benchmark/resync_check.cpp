@@ -0,0 +1,160 @@
+/*
+  Host-side check of the parser recovery after a frame cut short.
+
+  Build and run from the repository root with a desktop compiler:
+    g++ -O2 -std=c++11 -Iextras/benchmark -Isrc extras/benchmark/resync_check.cpp src/MyLD2410.cpp -o ld2410_resync
+    ./ld2410_resync
+
+  For every cut (from 1 byte of the header to one byte short of the tail), a data frame cut short
+  is followed by a valid frame and some line noise: the cut frame is only rejected once its declared
+  length has arrived, as on a live line. The valid frame must come out exactly once and unchanged:
+  from LD2410Core::Parser fed in one span and one byte at a time, and from MyLD2410::check()
+  reading the stream in full and in bursts of one byte. The exit code is the number of failures.
+*/
+#include "Arduino.h"
+#include "MockStream.h"
+#include "MyLD2410.h"
+#include <chrono>
+#include <thread>
+
+HostSerial Serial;
+
+static const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+
+unsigned long millis()
+{
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count();
+}
+
+unsigned long micros()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+}
+
+void delay(unsigned long ms)
+{
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+// The frame that follows the cut one: its payload in the script
+struct Expected
+{
+  bool ack;
+  size_t offset;
+  size_t size;
+};
+
+static unsigned long failures = 0;
+
+static void fail(const char *path, size_t cut, const char *next, const char *what)
+{
+  printf("FAIL %-12s cut %2zu + %-8s: %s\n", path, cut, next, what);
+  failures++;
+}
+
+static bool same(const MockStream &stream, const Expected &expected, const uint8_t *payload, unsigned int size)
+{
+  return (size == expected.size) && !memcmp(payload, stream.bytes() + expected.offset, size);
+}
+
+// Compare what the driver decoded with the expected payload
+static bool same(MyLD2410 &sensor, const MockStream &stream, const Expected &expected)
+{
+  const uint8_t *payload = stream.bytes() + expected.offset;
+  if (expected.ack)
+  { // The parameter reply: the thresholds of the 9 gates follow the max gates
+    const MyLD2410::ValuesArray &moving = sensor.getMovingThresholds(), &stationary = sensor.getStationaryThresholds();
+    return !memcmp(moving.values, payload + 8, 9) && !memcmp(stationary.values, payload + 17, 9);
+  }
+  MyLD2410::SensorData record{};
+  LD2410Core::decodeData(payload, record);
+  const MyLD2410::SensorData &data = sensor.getSensorData();
+  if ((data.status != record.status) || (data.mTargetDistance != record.mTargetDistance) ||
+      (data.mTargetSignal != record.mTargetSignal) || (data.sTargetDistance != record.sTargetDistance) ||
+      (data.sTargetSignal != record.sTargetSignal) || (data.distance != record.distance) ||
+      (data.mTargetSignals.N != record.mTargetSignals.N) || (data.sTargetSignals.N != record.sTargetSignals.N))
+    return false;
+  // The gate signals are only decoded from enhanced frames
+  return (payload[0] != 1) ||
+         (!memcmp(data.mTargetSignals.values, record.mTargetSignals.values, data.mTargetSignals.N + 1) &&
+          !memcmp(data.sTargetSignals.values, record.sTargetSignals.values, data.sTargetSignals.N + 1));
+}
+
+// Feed the script to the core parser in spans of the given size
+static void checkCore(const MockStream &stream, const Expected &expected, size_t span, size_t cut, const char *next)
+{
+  LD2410Core::Parser<LD2410_BUFFER_SIZE> parser;
+  const char *path = (span == 1) ? "core/byte" : "core/span";
+  const uint8_t *p = stream.bytes();
+  size_t n = stream.size();
+  unsigned long found = 0;
+  while (n || parser.pending())
+  {
+    LD2410Core::FrameType type;
+    size_t used = parser.feed(p, (n < span) ? n : span, type);
+    p += used;
+    n -= used;
+    if (type == LD2410Core::NONE)
+      continue;
+    found++;
+    if ((type == LD2410Core::ACK) != expected.ack)
+      fail(path, cut, next, "wrong frame type");
+    else if (!same(stream, expected, parser.payload(), parser.payloadSize()))
+      fail(path, cut, next, "payload differs");
+  }
+  if (found != 1)
+    fail(path, cut, next, (found) ? "more than one frame" : "no frame");
+}
+
+// Read the script through the driver, all at once or in bursts of one byte
+static void checkDriver(MockStream &stream, const Expected &expected, size_t burst, size_t cut, const char *next)
+{
+  const char *path = (burst == 1) ? "check/byte" : "check/all";
+  MyLD2410 sensor(stream);
+  stream.rewind();
+  stream.setBurst(burst);
+  unsigned long found = 0;
+  while (!stream.done())
+  {
+    MyLD2410::Response response = sensor.check();
+    if (response == MyLD2410::FAIL)
+      continue;
+    found++;
+    if ((response == MyLD2410::ACK) != expected.ack)
+      fail(path, cut, next, "wrong frame type");
+    else if (!same(sensor, stream, expected))
+      fail(path, cut, next, "decoded values differ");
+  }
+  if (found != 1)
+    fail(path, cut, next, (found) ? "more than one frame" : "no frame");
+  stream.setBurst(0);
+}
+
+int main()
+{
+  static const char *nextName[]{"basic", "enhanced", "ack"};
+  unsigned long cases = 0;
+  for (int next = 0; next < 3; next++)
+  {
+    // An enhanced data frame is 45 bytes long: cut it anywhere before its last byte
+    for (size_t cut = 1; cut < 45; cut++)
+    {
+      MockStream stream;
+      stream.truncate(cut);
+      size_t start = stream.size();
+      if (next == 2)
+        stream.ackParameters();
+      else
+        stream.data(next == 1);
+      Expected expected{next == 2, start + 6, stream.size() - start - 10};
+      stream.noise(45);
+      checkCore(stream, expected, stream.size(), cut, nextName[next]);
+      checkCore(stream, expected, 1, cut, nextName[next]);
+      checkDriver(stream, expected, 0, cut, nextName[next]);
+      checkDriver(stream, expected, 1, cut, nextName[next]);
+      cases++;
+    }
+  }
+  printf("%lu cases, %lu failures\n", cases, failures);
+  return (failures > 0xFF) ? 0xFF : failures;
+}
@@ -0,0 +1,480 @@
+#ifndef LD2410_CORE_H
+#define LD2410_CORE_H
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#ifndef LD2410_STATS
+#define LD2410_STATS 0
+#endif
+#ifndef LD2410_COUNT
+#if LD2410_STATS
+#define LD2410_COUNT(expr) (expr)
+#else
+#define LD2410_COUNT(expr)
+#endif
+#endif
+
+/*
+  The platform-independent core of the driver: the frame parser and the command encoder.
+  It works on byte spans and an injectable clock, without Arduino or Stream,
+  so the same code runs in MyLD2410 and on a host, e.g. a Linux gateway:
+
+    LD2410Core::Parser<> parser(clock);
+    while (n > 0) // n bytes read from the UART into bytes
+    {
+      LD2410Core::FrameType type;
+      size_t used = parser.feed(bytes, n, type);
+      bytes += used;
+      n -= used;
+      if (type == LD2410Core::DATA)
+        LD2410Core::decodeData(parser.payload(), record); // e.g. a MyLD2410::SensorData
+    }
+*/
+namespace LD2410Core
+{
+  /**
+   * @brief A clock in [ms], e.g. millis() on Arduino
+   */
+  typedef unsigned long (*Clock)();
+
+  // The same values as MyLD2410::Response
+  enum FrameType
+  {
+    NONE = 0,
+    ACK,
+    DATA
+  };
+
+  // The headers as they appear in a shift register, last received byte lowest
+  const uint32_t headDataWord = 0xF4F3F2F1;
+  const uint32_t headConfigWord = 0xFDFCFBFA;
+  const uint8_t headData[4]{0xF4, 0xF3, 0xF2, 0xF1};
+  const uint8_t headConfig[4]{0xFD, 0xFC, 0xFB, 0xFA};
+  const uint8_t tailData[4]{0xF8, 0xF7, 0xF6, 0xF5};
+  const uint8_t tailConfig[4]{4, 3, 2, 1};
+  // The payload lengths of the basic and the enhanced data frames
+  const unsigned int basicDataSize = 0x0D;
+  const unsigned int enhancedDataSize = 0x23;
+
+  inline uint16_t word(const uint8_t *p)
+  {
+    return p[0] | (p[1] << 8);
+  }
+
+  /**
+   * @brief Check a frame length field
+   *
+   * @param bufferSize - the room for the payload and the tail
+   */
+  inline bool validLength(FrameType type, unsigned int size, unsigned int bufferSize)
+  {
+    if (type == DATA)
+      return (size == basicDataSize) || (size == enhancedDataSize);
+    // Any ACK carries at least the command word and the status word
+    return (size >= 4) && (size <= bufferSize - 4);
+  }
+
+  /**
+   * @brief The parser counters (only with LD2410_STATS=1)
+   */
+  struct Counters
+  {
+    unsigned long framesParsed;   // frames that passed the tail check
+    unsigned long tailErrors;     // frames rejected by the tail check
+    unsigned long lengthErrors;   // frames rejected by the length check
+    unsigned long bytesDiscarded; // bytes skipped while hunting for a header, rejected frames included
+  };
+
+  /**
+   * @brief A resumable frame parser: feed it the received bytes in spans of any size.
+   * A frame is validated by its length and its tail. After a bad tail the parser looks for the next
+   * header inside the rejected frame, so a frame cut short does not cost the one that follows;
+   * if the cut frame happens to end on the tail of that one, the inner frame is kept.
+   *
+   * @tparam BufferSize - the room for the payload and the tail of the longest frame
+   */
+  template <unsigned int BufferSize = 0x40>
+  class Parser
+  {
+    static_assert(BufferSize <= 0xFF, "BufferSize must fit in a byte");
+    uint8_t buf[BufferSize];
+    uint8_t bufI = 0;
+    uint8_t spareI = 0; // buf[spareI, spareN) are bytes still to be scanned, see resync()
+    uint8_t spareN = 0;
+    unsigned int size = 0;
+    FrameType type = NONE;
+    bool intact = false;
+    uint32_t headWord = 0;
+    Clock clock;
+    unsigned long receivedAt = 0;
+    Counters counters{};
+
+    void startFrame(FrameType t)
+    {
+      type = t;
+      size = 0;
+      bufI = 0;
+      intact = false;
+      headWord = 0;
+    }
+
+    // Consume the bytes of the current frame: first the length (2 bytes), then the payload and the tail
+    bool readFrame(const uint8_t *&p, const uint8_t *end)
+    {
+      while (p < end)
+      {
+        if (!size)
+        {
+          buf[bufI++] = *(p++);
+          if (bufI < 2)
+            continue;
+          size = word(buf);
+          bufI = 0;
+          if (!validLength(type, size, BufferSize))
+          { // A corrupted length: the "length" may be the start of the next header, keep hunting from it
+            LD2410_COUNT(counters.lengthErrors++);
+            LD2410_COUNT(counters.bytesDiscarded += 6); // the header and the length
+            type = NONE;
+            headWord = (buf[0] << 8) | buf[1];
+            return false;
+          }
+          size += 4;
+          continue;
+        }
+        size_t n = end - p;
+        if (n > size - bufI)
+          n = size - bufI;
+        memcpy(buf + bufI, p, n);
+        bufI += n;
+        p += n;
+        if (bufI >= size)
+          return true;
+      }
+      return false;
+    }
+
+    // A frame cut short where the declared length ends right at the tail of a frame inside it
+    // passes the tail check with that tail: find the inner frame, return the offset of its payload, 0 if none
+    uint8_t nested(FrameType t) const
+    {
+      const uint8_t *head = (t == ACK) ? headConfig : headData;
+      // The inner header starts at i, its length follows, its tail ends at bufI
+      for (uint8_t i = 0; i + 10 <= bufI; i++)
+      {
+        const uint8_t *p = (const uint8_t *)memchr(buf + i, head[0], bufI - 9 - i);
+        if (!p)
+          return 0;
+        i = p - buf;
+        if (!memcmp(p, head, 4) && (i + 10 + word(p + 4) == bufI) && validLength(t, word(p + 4), BufferSize))
+          return i + 6;
+      }
+      return 0;
+    }
+
+    // buf holds a complete frame: check its tail. A bad tail usually means that the frame was cut
+    // short and the next one started inside it, so look for that one before hunting in the stream
+    FrameType validate()
+    {
+      for (;;)
+      {
+        FrameType t = type;
+        type = NONE;
+        if (!memcmp(buf + bufI - 4, (t == ACK) ? tailConfig : tailData, 4))
+        {
+          uint8_t inner = nested(t);
+          if (inner)
+          { // Keep the inner frame, and the spare bytes after it
+            LD2410_COUNT(counters.bytesDiscarded += inner);
+            uint8_t end = (spareN > bufI) ? spareN : bufI;
+            memmove(buf, buf + inner, end - inner);
+            bufI -= inner;
+            if (spareN)
+            {
+              spareI -= inner;
+              spareN -= inner;
+            }
+          }
+          LD2410_COUNT(counters.framesParsed++);
+          intact = true;
+          receivedAt = (clock) ? clock() : 0;
+          return t;
+        }
+        LD2410_COUNT(counters.tailErrors++);
+        LD2410_COUNT(counters.bytesDiscarded += 6); // the header and the length
+        // Rescan through the spare bytes too, if this frame was recovered from them
+        if (!resync(0, (spareN > bufI) ? spareN : bufI))
+          return NONE;
+      }
+    }
+
+    // Scan buf[from, n) for a header: all bytes are shifted to the front for the new frame,
+    // those after its end are kept as spare bytes, for the next scan
+    bool resync(uint8_t from, uint8_t n)
+    {
+      spareN = 0;
+      headWord = 0;
+      for (uint8_t i = from; i < n; i++)
+      {
+        headWord = (headWord << 8) | buf[i];
+        FrameType t = NONE;
+        if (headWord == headConfigWord)
+          t = ACK;
+        else if (headWord == headDataWord)
+          t = DATA;
+        uint8_t rest = n - i - 1;
+        if ((t == NONE) || ((rest >= 2) && !validLength(t, word(buf + i + 1), BufferSize)))
+          continue;
+        LD2410_COUNT(counters.bytesDiscarded += i - 3 - from);
+        startFrame(t);
+        if (rest < 2)
+        { // Resume in the length
+          memmove(buf, buf + i + 1, rest);
+          bufI = rest;
+          return false;
+        }
+        size = word(buf + i + 1) + 4;
+        rest -= 2;
+        memmove(buf, buf + i + 3, rest);
+        if (rest > size)
+        {
+          spareI = size;
+          spareN = rest;
+          rest = size;
+        }
+        bufI = rest;
+        return bufI >= size;
+      }
+      // No header: headWord holds the last bytes, the hunt goes on in the input
+      LD2410_COUNT(counters.bytesDiscarded += n - from);
+      return false;
+    }
+
+  public:
+    /**
+     * @brief Construct a new Parser object
+     *
+     * @param clock - stamps the frames, see timestamp()
+     */
+    explicit Parser(Clock clock = nullptr) : clock(clock) {}
+
+    void setClock(Clock c) { clock = c; }
+
+    /**
+     * @brief Drop the frame in progress and the spare bytes, e.g. after a gap in the input
+     */
+    void reset()
+    {
+      type = NONE;
+      spareN = 0;
+      headWord = 0;
+    }
+
+    /**
+     * @brief Consume the bytes up to and including the next header
+     *
+     * @return size_t - the number of bytes consumed
+     */
+    size_t hunt(const uint8_t *bytes, size_t n)
+    {
+      const uint8_t *p = bytes, *end = bytes + n;
+      while (p < end)
+      {
+        headWord = (headWord << 8) | *(p++);
+        LD2410_COUNT(counters.bytesDiscarded++);
+        if ((headWord == headConfigWord) || (headWord == headDataWord))
+        {
+          LD2410_COUNT(counters.bytesDiscarded -= 4);
+          startFrame((headWord == headConfigWord) ? ACK : DATA);
+          break;
+        }
+      }
+      return p - bytes;
+    }
+
+    /**
+     * @brief Consume bytes until a frame is complete and valid, or the span is used up.
+     * To be called again with the rest of the span after a frame, and with an empty span while pending().
+     *
+     * @param frame - the type of the completed frame, NONE if the frame is still incomplete
+     * @return size_t - the number of bytes consumed
+     */
+    size_t feed(const uint8_t *bytes, size_t n, FrameType &frame)
+    {
+      const uint8_t *p = bytes, *end = bytes + n;
+      frame = NONE;
+      while (spareN || (p < end))
+      {
+        if (spareN)
+        { // Bytes that followed a frame recovered by validate(): they are scanned before the input
+          if (!resync(spareI, spareN))
+            continue;
+        }
+        else if (type == NONE)
+        {
+          p += hunt(p, end - p);
+          continue;
+        }
+        else if (!readFrame(p, end))
+          continue; // The frame is incomplete, it is resumed on the next call
+        frame = validate();
+        if (frame != NONE)
+          break;
+      }
+      return p - bytes;
+    }
+
+    /**
+     * @brief Check whether a header was found and the parser is inside a frame
+     */
+    bool inFrame() const { return type != NONE; }
+
+    /**
+     * @brief Get the number of buffered bytes still to be scanned
+     */
+    unsigned int pending() const { return (spareN) ? spareN - spareI : 0; }
+
+    /**
+     * @brief Check whether the buffer still holds the last completed frame
+     */
+    bool hasFrame() const { return intact; }
+
+    /**
+     * @brief Get the payload of the last completed frame (without header, length and tail).
+     * It is valid while hasFrame()
+     */
+    const uint8_t *payload() const { return buf; }
+    unsigned int payloadSize() const { return bufI - 4; }
+
+    /**
+     * @brief Get the time of the last completed frame from the clock, 0 without a clock
+     */
+    unsigned long timestamp() const { return receivedAt; }
+
+    const Counters &getCounters() const { return counters; }
+    void resetCounters() { counters = Counters{}; }
+  };
+
+  /**
+   * @brief Check that a payload is a basic (type 2) or an enhanced (type 1) data frame
+   */
+  inline bool isDataFrame(const uint8_t *payload)
+  {
+    return ((payload[0] == 1) || (payload[0] == 2)) && (payload[1] == 0xAA);
+  }
+
+  /**
+   * @brief Decode a data frame payload into a record with the fields of MyLD2410::SensorData
+   * (the timestamp is left to the caller)
+   *
+   * @param signals - also decode the gate signals
+   * @return false if this is not a data frame
+   */
+  template <typename Record>
+  bool decodeData(const uint8_t *payload, Record &data, bool signals = true)
+  {
+    if (!isDataFrame(payload))
+      return false;
+    data.status = payload[2] & 3;
+    data.mTargetDistance = word(payload + 3);
+    data.mTargetSignal = payload[5];
+    data.sTargetDistance = word(payload + 6);
+    data.sTargetSignal = payload[8];
+    data.distance = word(payload + 9);
+    if (!signals)
+      return true;
+    if (payload[0] == 1)
+    { // Enhanced mode only
+      data.mTargetSignals.setN(payload[11]);
+      data.sTargetSignals.setN(payload[12]);
+      const uint8_t *p = payload + 13;
+      for (uint8_t i = 0; i <= data.mTargetSignals.N; i++)
+        data.mTargetSignals.values[i] = *(p++);
+      for (uint8_t i = 0; i <= data.sTargetSignals.N; i++)
+        data.sTargetSignals.values[i] = *(p++);
+    }
+    else
+    { // Basic mode only
+      data.mTargetSignals.setN(0);
+      data.sTargetSignals.setN(0);
+    }
+    return true;
+  }
+
+  /**
+   * @brief Get the command word of an ACK payload
+   */
+  inline uint16_t ackCommand(const uint8_t *payload)
+  {
+    return word(payload);
+  }
+
+  /**
+   * @brief Check the status word of an ACK payload
+   */
+  inline bool ackSuccess(const uint8_t *payload)
+  {
+    return !word(payload + 2);
+  }
+
+  /**
+   * @brief Encode a command frame (header, length, command word, value, tail)
+   *
+   * @param out - receives the frame
+   * @param capacity - the size of out
+   * @param command - the command word
+   * @param value - the command value, may be nullptr when valueSize is 0
+   * @return size_t - the frame length, 0 if it does not fit
+   */
+  inline size_t encodeCommand(uint8_t *out, size_t capacity, uint16_t command,
+                              const uint8_t *value = nullptr, size_t valueSize = 0)
+  {
+    size_t size = valueSize + 12;
+    if (size > capacity)
+      return 0;
+    memcpy(out, headConfig, 4);
+    out[4] = uint8_t(valueSize + 2);
+    out[5] = uint8_t((valueSize + 2) >> 8);
+    out[6] = uint8_t(command);
+    out[7] = uint8_t(command >> 8);
+    if (valueSize)
+      memcpy(out + 8, value, valueSize);
+    memcpy(out + 8 + valueSize, tailConfig, 4);
+    return size;
+  }
+
+  /**
+   * @brief Encode the "set gate sensitivity" command (0x64)
+   *
+   * @param gate - 0 - 8, any other value sets all gates
+   * @param movingThreshold - 0 - 100
+   * @param stationaryThreshold - 0 - 100
+   */
+  inline size_t encodeGateParameters(uint8_t *out, size_t capacity, uint8_t gate,
+                                     uint8_t movingThreshold, uint8_t stationaryThreshold)
+  {
+    uint8_t value[18]{0, 0, gate, 0, 0, 0, 1, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0};
+    if (gate > 8)
+      value[2] = value[3] = 0xFF;
+    value[8] = (movingThreshold > 100) ? 100 : movingThreshold;
+    value[14] = (stationaryThreshold > 100) ? 100 : stationaryThreshold;
+    return encodeCommand(out, capacity, 0x64, value, sizeof(value));
+  }
+
+  /**
+   * @brief Encode the "set max gates and no-one window" command (0x60)
+   *
+   * @param noOneWindow - [s]
+   */
+  inline size_t encodeMaxGate(uint8_t *out, size_t capacity, uint8_t movingGate,
+                              uint8_t stationaryGate, uint16_t noOneWindow)
+  {
+    uint8_t value[18]{0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0};
+    value[2] = (movingGate > 8) ? 8 : movingGate;
+    value[8] = (stationaryGate > 8) ? 8 : stationaryGate;
+    value[14] = uint8_t(noOneWindow);
+    value[15] = uint8_t(noOneWindow >> 8);
+    return encodeCommand(out, capacity, 0x60, value, sizeof(value));
+  }
+}
+
+#endif // LD2410_CORE_H
@@ -1,144 +1,710 @@
 #include "MyLD2410.h"
 
+#if defined(ESP32) || defined(ESP8266)
+#define LD2410_ISR IRAM_ATTR
+#else
+#define LD2410_ISR
+#endif
+// The AVR, Cortex-M0+ and ESP8266 cores do not ship the __atomic_* library calls that GCC emits
+// for a read-modify-write on those chips: there, the helpers below mask the interrupts instead
+#if defined(ESP32) || defined(ARDUINO_ARCH_RP2040)
+#define LD2410_ATOMIC_RMW 1
+#else
+#define LD2410_ATOMIC_RMW 0
+#endif
+
 /*** BEGIN LD2410 namespace ***/
 namespace LD2410
 {
   const char *tStatus[4]{"No target", "Moving only", "Stationary only", "Both moving and stationary"};
-  const byte headData[4]{0xF4, 0xF3, 0xF2, 0xF1};
-  const byte tailData[4]{0xF8, 0xF7, 0xF6, 0xF5};
-  const byte headConfig[4]{0xFD, 0xFC, 0xFB, 0xFA};
-  const byte tailConfig[4]{4, 3, 2, 1};
-  const byte configEnable[6]{4, 0, 0xFF, 0, 1, 0};
-  const byte configDisable[4]{2, 0, 0xFE, 0};
-  const byte MAC[6]{4, 0, 0xA5, 0, 1, 0};
-  const byte firmware[4]{2, 0, 0xA0, 0};
-  const byte res[4]{2, 0, 0xAB, 0};
-  const byte resCoarse[6]{4, 0, 0xAA, 0, 0, 0};
-  const byte resFine[6]{4, 0, 0xAA, 0, 1, 0};
-  const byte changeBaud[6]{4, 0, 0xA1, 0, 7, 0};
-  const byte reset[4]{2, 0, 0xA2, 0};
-  const byte reboot[4]{2, 0, 0xA3, 0};
-  const byte BTon[6]{4, 0, 0xA4, 0, 1, 0};
-  const byte BToff[6]{4, 0, 0xA4, 0, 0, 0};
-  const byte BTpasswd[10]{8, 0, 0xA9, 0, 0x48, 0x69, 0x4C, 0x69, 0x6E, 0x6B};
-  const byte param[4]{2, 0, 0x61, 0};
-  const byte engOn[4]{2, 0, 0x62, 0};
-  const byte engOff[4]{2, 0, 0x63, 0};
-  byte gateParam[0x16]{0x14, 0, 0x64, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0};
-  byte maxGate[0x16]{0x14, 0, 0x60, 0, 0, 0, 8, 0, 0, 0, 1, 0, 8, 0, 0, 0, 2, 0, 5, 0, 0, 0};
-
-  String byte2hex(byte b, bool addZero = true)
-  {
-    String bStr(b, HEX);
-    bStr.toUpperCase();
-    if (addZero && (bStr.length() == 1))
-      return "0" + bStr;
-    return bStr;
+  const unsigned long bauds[9]{0, 9600, 19200, 38400, 57600, 115200, 230400, 256000, 460800};
+  // The order in which detectBaud() tries the rates: the default first
+  const byte baudScan[8]{7, 8, 6, 5, 4, 3, 2, 1};
+  template <typename... T>
+  constexpr byte bodySize(T...)
+  {
+    return sizeof...(T);
   }
-  void printBuf(const byte *buf, byte size)
+// A complete command frame (header, length, command word and value, tail), generated at compile time and kept in flash
+#define LD2410_COMMAND(name, ...) \
+  const byte name[] PROGMEM { 0xFD, 0xFC, 0xFB, 0xFA, bodySize(__VA_ARGS__), 0, __VA_ARGS__, 4, 3, 2, 1 }
+  LD2410_COMMAND(configEnable, 0xFF, 0, 1, 0);
+  LD2410_COMMAND(configDisable, 0xFE, 0);
+  LD2410_COMMAND(MAC, 0xA5, 0, 1, 0);
+  LD2410_COMMAND(firmware, 0xA0, 0);
+  LD2410_COMMAND(res, 0xAB, 0);
+  LD2410_COMMAND(resCoarse, 0xAA, 0, 0, 0);
+  LD2410_COMMAND(resFine, 0xAA, 0, 1, 0);
+  LD2410_COMMAND(changeBaud, 0xA1, 0, 7, 0);
+  LD2410_COMMAND(reset, 0xA2, 0);
+  LD2410_COMMAND(reboot, 0xA3, 0);
+  LD2410_COMMAND(BTon, 0xA4, 0, 1, 0);
+  LD2410_COMMAND(BToff, 0xA4, 0, 0, 0);
+  LD2410_COMMAND(BTpasswd, 0xA9, 0, 0x48, 0x69, 0x4C, 0x69, 0x6E, 0x6B);
+  LD2410_COMMAND(param, 0x61, 0);
+  LD2410_COMMAND(engOn, 0x62, 0);
+  LD2410_COMMAND(engOff, 0x63, 0);
+  // The parameterized commands are built per call by LD2410Core, in a buffer owned by the caller
+#undef LD2410_COMMAND
+  // Indexed by MyLD2410::Command
+  const byte *const commands[]{configEnable, configDisable, MAC, firmware, res, resFine, resCoarse, param,
+                               engOn, engOff, BTon, BToff, BTpasswd, reset, reboot};
+
+  // Copy a command frame from flash
+  const byte *load(byte *frame, const byte *command)
   {
-    for (byte i = 0; i < size; i++)
+    memcpy_P(frame, command, pgm_read_byte(command + 4) + 10);
+    return frame;
+  }
+  byte threshold(byte value)
+  {
+    return (value > 100) ? 100 : value;
+  }
+  const byte *gateCommand(byte *frame, byte gate, byte movingThreshold, byte stationaryThreshold)
+  {
+    LD2410Core::encodeGateParameters(frame, LD2410_MAX_FRAME, gate, movingThreshold, stationaryThreshold);
+    return frame;
+  }
+  const byte *maxGateCommand(byte *frame, byte movingGate, byte staticGate, byte noOneWindow)
+  {
+    LD2410Core::encodeMaxGate(frame, LD2410_MAX_FRAME, movingGate, staticGate, noOneWindow);
+    return frame;
+  }
+  // Fletcher-16, seeded so that an all-zero block does not pass
+  uint16_t checksum(const byte *data, byte size)
+  {
+    uint16_t a = 'L', b = 'D';
+    while (size--)
     {
-      Serial.print(byte2hex(buf[i]));
-      Serial.print(' ');
+      a = (a + *(data++)) % 255;
+      b = (b + a) % 255;
     }
-    Serial.println();
-    Serial.flush();
+    return (b << 8) | a;
+  }
+  bool differs(unsigned long a, unsigned long b, unsigned int deadband)
+  {
+    return ((a > b) ? a - b : b - a) > deadband;
   }
-  bool bufferEndsWith(const byte *buf, int iMax, const byte *other)
+  // The histogram bin of a value: bin i counts the values below (base << i)
+  byte bin(unsigned long value, unsigned long base)
   {
-    for (int j = 3; j >= 0; j--)
+    byte i = 0;
+    while ((i < LD2410_HISTOGRAM_BINS - 1) && (value >= base))
     {
-      if (--iMax < 0)
-        iMax = 3;
-      if (buf[iMax] != other[j])
-        return false;
+      base <<= 1;
+      i++;
     }
-    return true;
+    return i;
+  }
+  // Atomic read-modify-write from the task context, see LD2410_ATOMIC_RMW
+  byte fetchOr(volatile byte &v, byte bits)
+  {
+#if LD2410_ATOMIC_RMW
+    return __atomic_fetch_or(&v, bits, __ATOMIC_ACQ_REL);
+#else
+    noInterrupts();
+    byte old = v;
+    v = old | bits;
+    interrupts();
+    return old;
+#endif
+  }
+  byte fetchAnd(volatile byte &v, byte bits)
+  {
+#if LD2410_ATOMIC_RMW
+    return __atomic_fetch_and(&v, bits, __ATOMIC_ACQ_REL);
+#else
+    noInterrupts();
+    byte old = v;
+    v = old & bits;
+    interrupts();
+    return old;
+#endif
+  }
+  // Set v to 0 if it still holds expected, return true if it did
+  bool clearIf(volatile unsigned int &v, unsigned int expected)
+  {
+#if LD2410_ATOMIC_RMW
+    return __atomic_compare_exchange_n(&v, &expected, 0, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#else
+    noInterrupts();
+    bool same = (v == expected);
+    if (same)
+      v = 0;
+    interrupts();
+    return same;
+#endif
+  }
+  void store(volatile unsigned int &v, unsigned int value)
+  {
+#if LD2410_ATOMIC_RMW
+    __atomic_store_n(&v, value, __ATOMIC_RELEASE);
+#else
+    noInterrupts();
+    v = value;
+    interrupts();
+#endif
+  }
+  // The pin interrupts of watchOutPin() and beginFast(): one trampoline per slot, each sets its bit
+  volatile byte outChanged = 0;
+  volatile byte outUsed = 0;
+  template <byte slot>
+  void LD2410_ISR outChange()
+  {
+#if LD2410_ATOMIC_RMW
+    __atomic_fetch_or(&outChanged, byte(1 << slot), __ATOMIC_RELAXED);
+#else
+    outChanged |= 1 << slot; // The interrupts are masked inside the ISR
+#endif
+  }
+  // Claim a free slot with an atomic bit set, so instances configured from different tasks never share one
+  int claimSlot()
+  {
+    for (byte slot = 0; slot < LD2410_OUT_SLOTS; slot++)
+      if (!(fetchOr(outUsed, 1 << slot) & (1 << slot)))
+        return slot;
+    return -1;
+  }
+  void releaseSlot(byte slot)
+  {
+    fetchAnd(outUsed, ~(1 << slot));
+  }
+  static_assert(LD2410_OUT_SLOTS <= 8, "LD2410_OUT_SLOTS must be at most 8");
+  void (*const outISR[8])(){outChange<0>, outChange<1>, outChange<2>, outChange<3>,
+                            outChange<4>, outChange<5>, outChange<6>, outChange<7>};
+  unsigned int nextHandle(unsigned int handle)
+  {
+    return (++handle) ? handle : 1;
+  }
+
+  // Format a byte as upper-case hex in place, return the end of the output
+  char *byte2hex(char *out, byte b, bool addZero = true)
+  {
+    const char *digits = "0123456789ABCDEF";
+    if (addZero || (b > 0x0F))
+      *(out++) = digits[b >> 4];
+    *(out++) = digits[b & 0x0F];
+    *out = 0;
+    return out;
+  }
+  void formatMAC(char *out, const byte *mac)
+  {
+    char *p = byte2hex(out, mac[0]);
+    for (int i = 1; i < 6; i++)
+    {
+      *(p++) = ':';
+      p = byte2hex(p, mac[i]);
+    }
+  }
+  void formatFirmware(char *out, const byte *raw)
+  {
+    char *p = byte2hex(out, raw[1], false);
+    *(p++) = '.';
+    p = byte2hex(p, raw[0]);
+    *(p++) = '.';
+    for (byte i = 5; i >= 2; i--)
+      p = byte2hex(p, raw[i]);
+  }
+  void printBuf(const byte *buf, byte size)
+  {
+    char hex[4];
+    for (byte i = 0; i < size; i++)
+    {
+      *byte2hex(hex, buf[i]) = ' ';
+      Serial.write((const uint8_t *)hex, 3);
+    }
+    Serial.println();
   }
 }
 /*** END LD2410 namespace ***/
 
-MyLD2410::Response MyLD2410::check()
+bool MyLD2410::DataQueue::push(const SensorData &data)
 {
-  while (sensor->available())
+  byte t = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+  byte next = (t + 1 == capacity) ? 0 : t + 1;
+  if (next == __atomic_load_n(&head, __ATOMIC_ACQUIRE))
   {
-    headBuf[headBufI++] = byte(sensor->read());
-    headBufI %= 4;
-    if (LD2410::bufferEndsWith(headBuf, headBufI, LD2410::headConfig) && processAck())
-      return ACK;
-    if (LD2410::bufferEndsWith(headBuf, headBufI, LD2410::headData) && processData())
-      return DATA;
+    droppedFrames++;
+    return false;
   }
-  return FAIL;
+  buf[t] = data;
+  __atomic_store_n(&tail, next, __ATOMIC_RELEASE);
+  return true;
 }
 
-bool MyLD2410::sendCommand(const byte *command)
+bool MyLD2410::DataQueue::pop(SensorData &data)
 {
-  byte size = command[0] + 2;
-  // LD2410::printBuf(command, size);
-  sensor->write(LD2410::headConfig, 4);
-  sensor->write(command, size);
-  sensor->write(LD2410::tailConfig, 4);
-  sensor->flush();
-  unsigned long giveUp = millis() + timeout;
-  while (millis() < giveUp)
+  byte h = __atomic_load_n(&head, __ATOMIC_RELAXED);
+  if (h == __atomic_load_n(&tail, __ATOMIC_ACQUIRE))
+    return false;
+  data = buf[h];
+  __atomic_store_n(&head, (h + 1 == capacity) ? 0 : h + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+MyLD2410::PackedSensorData::PackedSensorData(const SensorData &data)
+{
+  timestamp = uint16_t(data.timestamp / LD2410_PACKED_TICK);
+  mTargetDistance = uint16_t(data.mTargetDistance);
+  sTargetDistance = uint16_t(data.sTargetDistance);
+  distance = uint16_t(data.distance);
+  status = data.status;
+  gates = (data.mTargetSignals.N << 4) | data.sTargetSignals.N;
+  mTargetSignal = data.mTargetSignal;
+  sTargetSignal = data.sTargetSignal;
+  memcpy(mTargetSignals, data.mTargetSignals.values, 9);
+  memcpy(sTargetSignals, data.sTargetSignals.values, 9);
+}
+
+void MyLD2410::PackedSensorData::unpack(SensorData &data, unsigned long now) const
+{
+  // The latest tick count, not later than now, that ends with the stored 16 bits
+  unsigned long ticks = now / LD2410_PACKED_TICK;
+  data.timestamp = (ticks - uint16_t(uint16_t(ticks) - timestamp)) * LD2410_PACKED_TICK;
+  data.mTargetDistance = mTargetDistance;
+  data.sTargetDistance = sTargetDistance;
+  data.distance = distance;
+  data.status = status;
+  data.mTargetSignal = mTargetSignal;
+  data.sTargetSignal = sTargetSignal;
+  data.mTargetSignals.setN(gates >> 4);
+  data.sTargetSignals.setN(gates & 0x0F);
+  memcpy(data.mTargetSignals.values, mTargetSignals, 9);
+  memcpy(data.sTargetSignals.values, sTargetSignals, 9);
+}
+
+MyLD2410::SensorData MyLD2410::PackedSensorData::unpack() const
+{
+  SensorData data;
+  unpack(data, millis());
+  return data;
+}
+
+MyLD2410::Response MyLD2410::check()
+{
+#if LD2410_STATS
+  unsigned long start = micros();
+  Response response = fetch();
+  stats.checkTime[LD2410::bin(micros() - start, 16)]++;
+  return response;
+#else
+  return fetch();
+#endif
+}
+
+MyLD2410::Response MyLD2410::fetch()
+{
+  serviceCommands();
+  if (eventCallback && (lastStatus != 0xFF) && !isDataValid())
   {
-    while (sensor->available())
+    lastStatus = 0xFF;
+    if (inBand)
     {
-      headBuf[headBufI++] = byte(sensor->read());
-      headBufI %= 4;
-      if (LD2410::bufferEndsWith(headBuf, headBufI, LD2410::headConfig))
-        return processAck();
+      inBand = false;
+      eventCallback(EVENT_BAND_LEAVE, sData);
     }
+    eventCallback(EVENT_STALE, sData);
   }
-  return false;
+  if (rxQueue)
+  {
+    if (!rxQueue->pop(sData))
+      return FAIL;
+    onData();
+    return DATA;
+  }
+  if ((outPin < 0) || commandsPending())
+    return parse();
+  if (!gateOpen())
+    return FAIL;
+  Response response = parse();
+  if (response == DATA)
+  { // Back to sleep until the next change or interval
+    listening = false;
+    outAt = millis();
+  }
+  return response;
+}
+
+bool MyLD2410::gateOpen()
+{
+  if (listening)
+    return true;
+  byte bit = 1 << outSlot;
+  bool changed = LD2410::outChanged & bit;
+  if (!changed && (!outInterval || (millis() - outAt < outInterval)))
+    return false;
+  LD2410::fetchAnd(LD2410::outChanged, ~bit);
+  // Drop what piled up in the UART while nobody was listening, and start on a fresh frame
+  while (sensor->available() > 0)
+    sensor->read();
+  rxI = rxN = 0;
+  core.reset();
+  listening = true;
+  return true;
+}
+
+bool MyLD2410::watchOutPin(byte pin, unsigned long interval, unsigned long maxQuiet)
+{
+  if (outPin >= 0)
+    unwatchOutPin();
+  int slot = LD2410::claimSlot();
+  if (slot < 0)
+    return false;
+  outSlot = slot;
+  outPin = pin;
+  // Without an interval, still parse a frame after maxQuiet, so that a dead sensor goes stale
+  outInterval = (interval) ? interval : maxQuiet;
+  listening = true; // Parse one frame first, to start from up-to-date data
+  pinMode(pin, INPUT);
+  attachInterrupt(digitalPinToInterrupt(pin), LD2410::outISR[slot], CHANGE);
+  return true;
+}
+
+void MyLD2410::unwatchOutPin()
+{
+  if (outPin < 0)
+    return;
+  detachInterrupt(digitalPinToInterrupt(outPin));
+  LD2410::releaseSlot(outSlot);
+  outPin = -1;
+  listening = true;
+}
+
+bool MyLD2410::outPinPresence()
+{
+  return (outPin >= 0) && (digitalRead(outPin) == HIGH);
+}
+
+bool MyLD2410::isListening()
+{
+  return listening;
+}
+
+void MyLD2410::attachQueue(DataQueue &queue)
+{
+  rxQueue = &queue;
 }
-bool MyLD2410::readFrame()
+
+void MyLD2410::detachQueue()
+{
+  rxQueue = nullptr;
+}
+
+#if LD2410_STATS
+const MyLD2410::Stats &MyLD2410::getStats()
+{
+  // The frame counters are kept by the parser core
+  const LD2410Core::Counters &counters = core.getCounters();
+  stats.framesParsed = counters.framesParsed;
+  stats.tailErrors = counters.tailErrors;
+  stats.lengthErrors = counters.lengthErrors;
+  stats.bytesDiscarded = counters.bytesDiscarded;
+  return stats;
+}
+
+void MyLD2410::resetStats()
+{
+  stats = Stats{};
+  core.resetCounters();
+}
+#endif
+
+void MyLD2410::onEvent(EventCallback callback)
+{
+  eventCallback = callback;
+  lastStatus = 0xFF;
+  inBand = false;
+}
+
+void MyLD2410::setDistanceBand(unsigned long from, unsigned long to)
+{
+  bandFrom = from;
+  bandTo = to;
+  inBand = false;
+}
+
+bool MyLD2410::inDistanceBand()
+{
+  return inBand;
+}
+
+void MyLD2410::setTraceSink(TraceSink &sink)
+{
+  traceSink = &sink;
+}
+
+void MyLD2410::clearTraceSink()
+{
+  traceSink = nullptr;
+}
+
+void MyLD2410::attachHistory(DataHistory &h)
+{
+  history = &h;
+}
+
+void MyLD2410::detachHistory()
+{
+  history = nullptr;
+}
+
+void MyLD2410::attachFilter(SignalFilter &f)
+{
+  f.reset();
+  filter = &f;
+}
+
+void MyLD2410::detachFilter()
+{
+  filter = nullptr;
+}
+
+void MyLD2410::SignalFilter::filter(ValuesArray &signals, byte k)
+{
+  byte *v = signals.values;
+  byte(*w)[2] = window[k];
+  uint16_t *e = ema[k];
+  if (primedN[k] != signals.N)
+  { // A new mode or the first frame: start from this one
+    primedN[k] = signals.N;
+    for (byte i = 0; i < 9; i++)
+    {
+      w[i][0] = w[i][1] = v[i];
+      e[i] = v[i] << 8;
+    }
+    return;
+  }
+  // All 9 gates are processed (the unused ones are ignored), so the loops have a fixed trip count
+  // and no branches: the compiler may unroll or vectorize them
+  if (median)
+    for (byte i = 0; i < 9; i++)
+    {
+      byte a = w[i][0], b = w[i][1], c = v[i];
+      w[i][0] = b;
+      w[i][1] = c;
+      byte lo = (a < b) ? a : b, hi = (a < b) ? b : a;
+      byte m = (hi < c) ? hi : c;
+      v[i] = (lo > m) ? lo : m;
+    }
+  if (alpha)
+    for (byte i = 0; i < 9; i++)
+    {
+      e[i] = uint16_t(int32_t(e[i]) + ((int32_t((v[i] << 8) - e[i]) * alpha) >> 8));
+      v[i] = (e[i] + 0x80) >> 8;
+    }
+}
+
+void MyLD2410::SignalFilter::apply(SensorData &data)
 {
-  int frameSize = -1, bytes = 2;
-  if (bytes > 0)
+  if (data.mTargetSignals.N || data.sTargetSignals.N)
+  {
+    filter(data.mTargetSignals, 0);
+    filter(data.sTargetSignals, 1);
+  }
+  if (!hold)
+    return;
+  if (data.status == status)
+    streak = 0;
+  else if (streak && (data.status == candidate))
   {
-    inBufI = 0;
-    while (bytes)
+    if (++streak >= hold)
     {
-      if (sensor->available())
-      {
-        inBuf[inBufI++] = byte(sensor->read());
-        bytes--;
-      }
+      status = candidate;
+      streak = 0;
     }
-    frameSize = 0;
-    for (byte i = 0; i < inBufI; i++)
+  }
+  else
+  {
+    candidate = data.status;
+    streak = 1;
+    if (hold <= 1)
     {
-      frameSize |= inBuf[i] << i * 8;
+      status = candidate;
+      streak = 0;
     }
   }
-  if (frameSize <= 0)
-    return false;
-  frameSize += 4;
-  inBufI = 0;
-  while (frameSize > 0)
+  data.status = status;
+}
+
+void MyLD2410::receive()
+{
+  while (parse() != FAIL)
+    ;
+}
+
+int MyLD2410::available()
+{
+  return sensor->available() + (rxN - rxI) + core.pending();
+}
+
+MyLD2410::Response MyLD2410::parse()
+{
+  while (core.pending() || (rxI < rxN) || fillRx())
   {
-    if (sensor->available())
+    LD2410Core::FrameType type;
+    rxI += core.feed(rxBuf + rxI, rxN - rxI, type);
+    if (type == LD2410Core::NONE)
+      continue; // The frame is incomplete, it is resumed on the next call
+    if (!rxQueue)
+      dataInBuf = false;
+    if (_debug)
+      LD2410::printBuf(core.payload(), core.payloadSize() + 4);
+    if (type == LD2410Core::ACK)
     {
-      inBuf[inBufI++] = byte(sensor->read());
-      frameSize--;
+      bool success = processAck();
+      unsigned int h = cmdInFlight;
+      if (h)
+      { // Complete the command in flight, if this is its reply
+        const byte *frame = cmdQueue[h % LD2410_COMMAND_QUEUE].frame;
+        if (LD2410Core::ackCommand(core.payload()) == (LD2410Core::word(frame + 6) | 0x100))
+          finishCommand(h, (success) ? COMMAND_DONE : COMMAND_FAILED);
+      }
+      if (success)
+        return ACK;
     }
+    else if (processData())
+      return DATA;
   }
-  return true;
+  return FAIL;
 }
 
-bool MyLD2410::processAck()
+bool MyLD2410::sendCommand(const byte *command)
 {
-  if (!readFrame())
+  byte frame[LD2410_MAX_FRAME];
+  return sendFrame(LD2410::load(frame, command));
+}
+
+bool MyLD2410::sendFrame(const byte *frame)
+{
+  if (frame[4] + 10 > LD2410_MAX_FRAME)
     return false;
-  if (_debug)
-    LD2410::printBuf(inBuf, inBufI);
-  if (!LD2410::bufferEndsWith(inBuf, inBufI, LD2410::tailConfig))
+  unsigned int h;
+  while (!(h = enqueue(frame, nullptr, false)))
+    pump(); // The queue is full, wait for a free slot
+  CommandStatus status;
+  while ((status = commandStatus(h)) < COMMAND_DONE)
+    pump();
+  return status == COMMAND_DONE;
+}
+
+void MyLD2410::pump()
+{
+  serviceCommands();
+  // With an attached queue, the ACK is processed by receive()
+  if (!rxQueue)
+    parse();
+}
+
+unsigned int MyLD2410::enqueue(const byte *frame, CommandCallback callback, bool batched)
+{
+  byte size = frame[4] + 10;
+  PendingCommand &slot = cmdQueue[cmdNew % LD2410_COMMAND_QUEUE];
+  if ((size > LD2410_MAX_FRAME) || (slot.handle && (slot.status < COMMAND_DONE)))
+    return 0;
+  memcpy(slot.frame, frame, size);
+  slot.callback = callback;
+  slot.batched = batched;
+  slot.status = COMMAND_PENDING;
+  slot.handle = cmdNew;
+  cmdNew = LD2410::nextHandle(cmdNew);
+  return slot.handle;
+}
+
+void MyLD2410::serviceCommands()
+{
+  unsigned int h = cmdInFlight;
+  if (h)
+  {
+    if (millis() - cmdSentAt >= timeout)
+      finishCommand(h, COMMAND_TIMEOUT);
+    return;
+  }
+  if (cmdNext == cmdNew)
+    return;
+  PendingCommand &slot = cmdQueue[cmdNext % LD2410_COMMAND_QUEUE];
+  cmdSentAt = millis();
+  // Mark the slot sent before anything else can see it: the ACK may be processed by receive()
+  // in another task as soon as the frame is out, and its DONE must not be overwritten
+  slot.status = COMMAND_SENT;
+  h = cmdNext;
+  LD2410::store(cmdInFlight, h);
+  cmdNext = LD2410::nextHandle(cmdNext);
+  if (slot.batched && !txnSuccess && (slot.frame[6] != 0xFE))
+  { // Skip the rest of a failed transaction, but still leave config mode
+    finishCommand(h, COMMAND_FAILED);
+    return;
+  }
+  // LD2410::printBuf(slot.frame, slot.frame[4] + 10);
+  sensor->write(slot.frame, slot.frame[4] + 10);
+}
+
+void MyLD2410::finishCommand(unsigned int handle, CommandStatus status)
+{
+  // Either the ACK or the timeout completes the command, whichever comes first
+  if (!LD2410::clearIf(cmdInFlight, handle))
+    return;
+  PendingCommand &slot = cmdQueue[handle % LD2410_COMMAND_QUEUE];
+  if (slot.batched && (status != COMMAND_DONE))
+    txnSuccess = false;
+  LD2410_COUNT(stats.ackTimeouts += (status == COMMAND_TIMEOUT));
+  slot.status = status;
+  if (slot.callback)
+    slot.callback(handle, slot.frame[6] | (slot.frame[7] << 8), status);
+}
+
+unsigned int MyLD2410::enqueueCommand(Command command, CommandCallback callback)
+{
+  if (command > CMD_REBOOT)
+    return 0;
+  byte frame[LD2410_MAX_FRAME];
+  return enqueue(LD2410::load(frame, LD2410::commands[command]), callback, false);
+}
+
+unsigned int MyLD2410::enqueueGateParameters(byte gate, byte movingThreshold, byte stationaryThreshold, CommandCallback callback)
+{
+  byte frame[LD2410_MAX_FRAME];
+  return enqueue(LD2410::gateCommand(frame, gate, movingThreshold, stationaryThreshold), callback, false);
+}
+
+unsigned int MyLD2410::enqueueMaxGate(byte movingGate, byte stationaryGate, byte noOneWindow, CommandCallback callback)
+{
+  byte frame[LD2410_MAX_FRAME];
+  return enqueue(LD2410::maxGateCommand(frame, movingGate, stationaryGate, noOneWindow), callback, false);
+}
+
+MyLD2410::CommandStatus MyLD2410::commandStatus(unsigned int handle)
+{
+  const PendingCommand &slot = cmdQueue[handle % LD2410_COMMAND_QUEUE];
+  if (!handle || (slot.handle != handle))
+    return COMMAND_UNKNOWN;
+  return CommandStatus(slot.status);
+}
+
+bool MyLD2410::commandsPending()
+{
+  return cmdInFlight || (cmdNext != cmdNew);
+}
+
+bool MyLD2410::fillRx()
+{
+  // Drain the stream in chunks. Only buffered bytes are requested, so readBytes() never waits
+  int n = sensor->available();
+  if (n <= 0)
     return false;
-  unsigned long command = inBuf[0] | (inBuf[1] << 8);
-  if (inBuf[2] | (inBuf[3] << 8))
+  if (n > LD2410_RX_CHUNK)
+    n = LD2410_RX_CHUNK;
+  rxI = 0;
+  rxN = sensor->readBytes(rxBuf, n);
+  return rxN > 0;
+}
+
+bool MyLD2410::processAck()
+{
+  const byte *inBuf = core.payload();
+  if (traceSink)
+    traceSink->trace(inBuf, core.payloadSize(), ACK, core.timestamp());
+  unsigned long command = LD2410Core::ackCommand(inBuf);
+  if (!LD2410Core::ackSuccess(inBuf))
     return false;
   switch (command)
   {
@@ -151,22 +717,19 @@ bool MyLD2410::processAck()
     isConfig = false;
     break;
   case 0x1A5: // MAC
+  {
     for (int i = 0; i < 6; i++)
       MAC[i] = inBuf[i + 4];
-    MACstr = LD2410::byte2hex(MAC[0]);
-    for (int i = 1; i < 6; i++)
-      MACstr += ":" + LD2410::byte2hex(MAC[i]);
+    LD2410::formatMAC(MACstr, MAC);
     break;
+  }
   case 0x1A0: // Firmware
-    firmware = LD2410::byte2hex(inBuf[7], false);
-    firmware += "." + LD2410::byte2hex(inBuf[6]);
-    firmware += "." + LD2410::byte2hex(inBuf[11]);
-    firmware += LD2410::byte2hex(inBuf[10]);
-    firmware += LD2410::byte2hex(inBuf[9]);
-    firmware += LD2410::byte2hex(inBuf[8]);
+    memcpy(firmwareRaw, inBuf + 6, sizeof(firmwareRaw));
+    LD2410::formatFirmware(firmware, firmwareRaw);
     break;
   case 0x1AB: // Query Resolution
     fineRes = (inBuf[4]);
+    updateZones();
     break;
   case 0x1A3: // Reboot
     isEnhanced = false;
@@ -176,9 +739,10 @@ bool MyLD2410::processAck()
     maxRange = inBuf[5];
     movingThresholds.setN(inBuf[6]);
     stationaryThresholds.setN(inBuf[7]);
-    for (byte i = 0; i <= movingThresholds.N; i++)
+    // Keep all 9 thresholds, including the gates beyond N, for syncGateParameters()
+    for (byte i = 0; i < 9; i++)
       movingThresholds.values[i] = inBuf[8 + i];
-    for (byte i = 0; i <= stationaryThresholds.N; i++)
+    for (byte i = 0; i < 9; i++)
       stationaryThresholds.values[i] = inBuf[17 + i];
     noOne_window = inBuf[26] | (inBuf[27] << 8);
     break;
@@ -188,53 +752,222 @@ bool MyLD2410::processAck()
   case 0x163:
     isEnhanced = false;
     break;
-  case 0x164:
-    if (LD2410::gateParam[7] == 0xFF)
-      LD2410::gateParam[7] = 0;
   }
   return (true);
 }
 
 bool MyLD2410::processData()
 {
-  if (!readFrame())
+  const byte *inBuf = core.payload();
+  unsigned long now = core.timestamp();
+  if (traceSink)
+    traceSink->trace(inBuf, core.payloadSize(), DATA, now);
+  // With an attached queue, the record is decoded on the side and pushed to the queue
+  SensorData &data = (rxQueue) ? rxData : sData;
+  if (!LD2410Core::isDataFrame(inBuf))
+  {
+    LD2410_COUNT(stats.unknownFrames++);
     return false;
-  if (_debug)
-    LD2410::printBuf(inBuf, inBufI);
-  if (!LD2410::bufferEndsWith(inBuf, inBufI, LD2410::tailData))
+  }
+  if (changesOnly && !isSignificant(now))
     return false;
-  if (((inBuf[0] == 1) || (inBuf[0] == 2)) && (inBuf[1] == 0xAA))
-  { // Basic mode and Enhanced
-    sData.timestamp = millis();
-    sData.status = inBuf[2] & 3;
-    sData.mTargetDistance = inBuf[3] | (inBuf[4] << 8);
-    sData.mTargetSignal = inBuf[5];
-    sData.sTargetDistance = inBuf[6] | (inBuf[7] << 8);
-    sData.sTargetSignal = inBuf[8];
-    sData.distance = inBuf[9] | (inBuf[10] << 8);
-    if (inBuf[0] == 1)
-    { // Enhanced mode only
-      sData.mTargetSignals.setN(inBuf[11]);
-      sData.sTargetSignals.setN(inBuf[12]);
-      byte *p = inBuf + 13;
-      for (byte i = 0; i <= sData.mTargetSignals.N; i++)
-        sData.mTargetSignals.values[i] = *(p++);
-      for (byte i = 0; i <= sData.sTargetSignals.N; i++)
-        sData.sTargetSignals.values[i] = *(p++);
-      lightLevel = (*p > 80) ? *p : 0;
-    }
-    else
-    { // Basic mode only
-      sData.mTargetSignals.setN(0);
-      sData.sTargetSignals.setN(0);
-      lightLevel = 0;
-    }
+  reportedAt = now;
+  reportNext = false;
+  data.timestamp = now;
+  // With lazy signals, the signals stay in the frame buffer, see getFrameView()
+  LD2410Core::decodeData(inBuf, data, !lazySignals);
+  if (changesOnly)
+    reported = PackedSensorData(data);
+#if LD2410_STATS
+  stats.frameInterval[LD2410::bin(data.timestamp - lastDataAt, 25)]++;
+  lastDataAt = data.timestamp;
+#endif
+  if (rxQueue)
+  { // Only the record crosses over: the frame view and the light level belong to check()
+    rxQueue->push(rxData);
+    return true;
   }
-  else
+  lightLevel = FrameView(inBuf).lightLevel();
+  dataInBuf = true;
+  onData();
+  return true;
+}
+
+void MyLD2410::onData()
+{
+  // sData holds a new frame (on the consumer side, when a queue is attached)
+  if (filter)
+    filter->apply(sData);
+  updateOccupancy();
+  if (history)
+    history->record(sData);
+  if (eventCallback)
+    raiseEvents();
+}
+
+bool MyLD2410::DeviceDescriptor::valid() const
+{
+  return checksum == LD2410::checksum((const byte *)this, offsetof(DeviceDescriptor, checksum));
+}
+
+bool MyLD2410::getDescriptor(DeviceDescriptor &d)
+{
+  if (inTransaction)
     return false;
+  if (!MACstr[0] || !firmware[0] || (fineRes < 0) || !maxRange || !version)
+  { // Query what is missing in a single session (entering config mode reports the version)
+    beginTransaction();
+    if (!MACstr[0])
+      requestMAC();
+    if (!firmware[0])
+      requestFirmware();
+    if (fineRes < 0)
+      requestResolution();
+    if (!maxRange)
+      requestParameters();
+    if (!endTransaction())
+      return false;
+  }
+  d.version = version;
+  d.bufferSize = bufferSize;
+  memcpy(d.MAC, MAC, sizeof(d.MAC));
+  memcpy(d.firmware, firmwareRaw, sizeof(d.firmware));
+  d.resolution = fineRes;
+  d.maxRange = maxRange;
+  d.movingGates = movingThresholds.N;
+  d.stationaryGates = stationaryThresholds.N;
+  memcpy(d.movingThresholds, movingThresholds.values, 9);
+  memcpy(d.stationaryThresholds, stationaryThresholds.values, 9);
+  d.noOneWindow = noOne_window;
+  d.reserved = 0;
+  d.checksum = LD2410::checksum((const byte *)&d, offsetof(DeviceDescriptor, checksum));
   return true;
 }
 
+bool MyLD2410::loadDescriptor(const DeviceDescriptor &d, bool verify)
+{
+  if (!d.valid())
+    return false;
+  if (verify && !(requestMAC() && !memcmp(MAC, d.MAC, sizeof(MAC))))
+    return false;
+  version = d.version;
+  bufferSize = d.bufferSize;
+  memcpy(MAC, d.MAC, sizeof(MAC));
+  LD2410::formatMAC(MACstr, MAC);
+  memcpy(firmwareRaw, d.firmware, sizeof(firmwareRaw));
+  LD2410::formatFirmware(firmware, firmwareRaw);
+  fineRes = d.resolution;
+  maxRange = d.maxRange;
+  movingThresholds.setN(d.movingGates);
+  stationaryThresholds.setN(d.stationaryGates);
+  memcpy(movingThresholds.values, d.movingThresholds, 9);
+  memcpy(stationaryThresholds.values, d.stationaryThresholds, 9);
+  noOne_window = d.noOneWindow;
+  updateZones();
+  return true;
+}
+
+void MyLD2410::updateOccupancy()
+{
+  movingOccupancy = stationaryOccupancy = 0;
+  if (!maxRange)
+    return; // The thresholds are unknown
+  const byte *m = sData.mTargetSignals.values, *s = sData.sTargetSignals.values;
+  byte mN = sData.mTargetSignals.N, sN = sData.sTargetSignals.N;
+  if (lazySignals)
+  { // The signals are still in the frame buffer
+    FrameView frame = getFrameView();
+    if (!frame.valid() || !frame.enhanced())
+      return;
+    m = frame.movingSignals();
+    s = frame.stationarySignals();
+    mN = frame.movingGates();
+    sN = frame.stationaryGates();
+  }
+  for (byte i = 0; i <= mN; i++)
+    movingOccupancy |= uint16_t(m[i] > movingThresholds.values[i]) << i;
+  for (byte i = 0; i <= sN; i++)
+    stationaryOccupancy |= uint16_t(s[i] > stationaryThresholds.values[i]) << i;
+  if (!(mN | sN))
+    movingOccupancy = stationaryOccupancy = 0; // Basic mode
+}
+
+void MyLD2410::updateZones()
+{
+  unsigned int width = (fineRes == 1) ? 20 : 75;
+  for (byte z = 0; z < LD2410_ZONES; z++)
+  {
+    zoneMask[z] = 0;
+    if (!zoneTo[z])
+      continue; // Not defined
+    for (byte i = 0; i < 9; i++)
+      if ((i * width < zoneTo[z]) && ((i + 1) * width > zoneFrom[z]))
+        zoneMask[z] |= 1 << i;
+  }
+}
+
+uint16_t MyLD2410::getMovingOccupancy()
+{
+  return (isDataValid()) ? movingOccupancy : 0;
+}
+
+uint16_t MyLD2410::getStationaryOccupancy()
+{
+  return (isDataValid()) ? stationaryOccupancy : 0;
+}
+
+uint16_t MyLD2410::getOccupancy()
+{
+  return (isDataValid()) ? (movingOccupancy | stationaryOccupancy) : 0;
+}
+
+bool MyLD2410::setZone(byte zone, unsigned int from, unsigned int to)
+{
+  if ((zone >= LD2410_ZONES) || !to || (to < from))
+    return false;
+  zoneFrom[zone] = from;
+  zoneTo[zone] = to;
+  updateZones();
+  return true;
+}
+
+uint16_t MyLD2410::getZoneMask(byte zone)
+{
+  return (zone < LD2410_ZONES) ? zoneMask[zone] : 0;
+}
+
+bool MyLD2410::zoneOccupied(byte zone)
+{
+  return getOccupancy() & getZoneMask(zone);
+}
+
+bool MyLD2410::zoneMoving(byte zone)
+{
+  return getMovingOccupancy() & getZoneMask(zone);
+}
+
+bool MyLD2410::zoneStationary(byte zone)
+{
+  return getStationaryOccupancy() & getZoneMask(zone);
+}
+
+void MyLD2410::raiseEvents()
+{
+  if (sData.status != lastStatus)
+  {
+    lastStatus = sData.status;
+    eventCallback(EVENT_STATUS, sData);
+  }
+  if (!bandTo)
+    return;
+  bool in = sData.status && (sData.distance >= bandFrom) && (sData.distance <= bandTo);
+  if (in != inBand)
+  {
+    inBand = in;
+    eventCallback((in) ? EVENT_BAND_ENTER : EVENT_BAND_LEAVE, sData);
+  }
+}
+
 /**
 @brief Construct from a serial stream object
 */
@@ -261,8 +994,56 @@ bool MyLD2410::begin()
   return online;
 }
 
+bool MyLD2410::beginFast(int pin)
+{
+  unsigned long start = micros(), startMs = millis();
+  wakeUpTime = 0;
+  core.reset();
+  // The wake flag is this instance's slot bit; without a free slot, poll the stream
+  int slot = (pin >= 0) ? LD2410::claimSlot() : -1;
+  byte bit = (slot >= 0) ? 1 << slot : 0;
+  if (bit)
+  {
+    LD2410::fetchAnd(LD2410::outChanged, ~bit);
+    attachInterrupt(digitalPinToInterrupt(pin), LD2410::outISR[slot], CHANGE);
+  }
+  while (millis() - startMs < timeout)
+  {
+    if (bit && !(LD2410::outChanged & bit))
+    {
+      yield();
+      continue;
+    }
+    while (!core.inFrame() && ((rxI < rxN) || fillRx()))
+      rxI += core.hunt(rxBuf + rxI, rxN - rxI);
+    if (core.inFrame())
+    {
+      wakeUpTime = micros() - start;
+      if (!wakeUpTime)
+        wakeUpTime = 1;
+      break;
+    }
+    yield();
+  }
+  if (bit)
+  {
+    detachInterrupt(digitalPinToInterrupt(pin));
+    LD2410::fetchAnd(LD2410::outChanged, ~bit);
+    LD2410::releaseSlot(slot);
+  }
+  return wakeUpTime;
+}
+
+unsigned long MyLD2410::getWakeUpTime()
+{
+  return wakeUpTime;
+}
+
 void MyLD2410::end()
 {
+  unwatchOutPin();
+  rxI = rxN = 0;
+  core.reset();
   isConfig = false;
   isEnhanced = false;
 }
@@ -294,7 +1075,41 @@ const char *MyLD2410::statusString()
 
 bool MyLD2410::isDataValid()
 {
-  return (millis() - sData.timestamp < dataLifespan);
+  unsigned long lifespan = dataLifespan;
+  if (changesOnly)
+    lifespan += heartbeat;
+  if (outPin >= 0) // While the OUT pin is quiet, the presence has not changed since the last frame
+    lifespan += outInterval;
+  return (millis() - sData.timestamp < lifespan);
+}
+
+bool MyLD2410::isSignificant(unsigned long now)
+{
+  // Compare the raw frame against the last reported frame as it was decoded, so that
+  // the smoothing and the hysteresis of an attached filter do not feed back into the decision
+  const byte *inBuf = core.payload();
+  const PackedSensorData &last = reported;
+  if (reportNext || (now - reportedAt >= heartbeat) || ((inBuf[2] & 3) != last.status))
+    return true;
+  if (LD2410::differs(inBuf[3] | (inBuf[4] << 8), last.mTargetDistance, distanceDeadband) ||
+      LD2410::differs(inBuf[6] | (inBuf[7] << 8), last.sTargetDistance, distanceDeadband) ||
+      LD2410::differs(inBuf[9] | (inBuf[10] << 8), last.distance, distanceDeadband))
+    return true;
+  if (lazySignals)
+    return false;
+  FrameView frame(inBuf);
+  byte mN = last.gates >> 4, sN = last.gates & 0x0F;
+  if ((frame.movingGates() != mN) || (frame.stationaryGates() != sN))
+    return true;
+  if (!frame.enhanced())
+    return false;
+  for (byte i = 0; i <= mN; i++)
+    if (LD2410::differs(frame.movingSignals()[i], last.mTargetSignals[i], signalTolerance))
+      return true;
+  for (byte i = 0; i <= sN; i++)
+    if (LD2410::differs(frame.stationarySignals()[i], last.sTargetSignals[i], signalTolerance))
+      return true;
+  return false;
 }
 
 bool MyLD2410::presenceDetected()
@@ -349,21 +1164,21 @@ unsigned long MyLD2410::detectedDistance()
 
 const byte *MyLD2410::getMAC()
 {
-  if (MACstr.length() == 0)
+  if (!MACstr[0] && !inTransaction)
     requestMAC();
   return MAC;
 }
 
-String MyLD2410::getMACstr()
+const char *MyLD2410::getMACstr()
 {
-  if (MACstr.length() == 0)
+  if (!MACstr[0] && !inTransaction)
     requestMAC();
   return MACstr;
 }
 
-String MyLD2410::getFirmware()
+const char *MyLD2410::getFirmware()
 {
-  if (firmware.length() == 0)
+  if (!firmware[0] && !inTransaction)
     requestFirmware();
   return firmware;
 }
@@ -378,23 +1193,47 @@ const MyLD2410::SensorData &MyLD2410::getSensorData()
   return sData;
 }
 
+MyLD2410::FrameView MyLD2410::getFrameView()
+{
+  return FrameView((dataInBuf && core.hasFrame()) ? core.payload() : nullptr);
+}
+
+void MyLD2410::reportChangesOnly(unsigned long heartbeat, unsigned int deadband, byte tolerance)
+{
+  this->heartbeat = heartbeat;
+  distanceDeadband = deadband;
+  signalTolerance = tolerance;
+  reportNext = true;
+  changesOnly = true;
+}
+
+void MyLD2410::reportAllFrames()
+{
+  changesOnly = false;
+}
+
+void MyLD2410::setLazyDecoding(bool lazy)
+{
+  lazySignals = lazy;
+}
+
 const MyLD2410::ValuesArray &MyLD2410::getMovingThresholds()
 {
-  if (!maxRange)
+  if (!maxRange && !inTransaction)
     requestParameters();
   return movingThresholds;
 }
 
 const MyLD2410::ValuesArray &MyLD2410::getStationaryThresholds()
 {
-  if (!maxRange)
+  if (!maxRange && !inTransaction)
     requestParameters();
   return stationaryThresholds;
 }
 
 byte MyLD2410::getRange()
 {
-  if (!maxRange)
+  if (!maxRange && !inTransaction)
     requestParameters();
   return maxRange;
 }
@@ -406,11 +1245,78 @@ unsigned long MyLD2410::getRange_cm()
 
 byte MyLD2410::getNoOneWindow()
 {
-  if (!maxRange)
+  if (!maxRange && !inTransaction)
     requestParameters();
   return noOne_window;
 }
 
+bool MyLD2410::run(const byte *command, const byte *readBack)
+{
+  byte frame[LD2410_MAX_FRAME];
+  return runFrame(LD2410::load(frame, command), readBack);
+}
+
+bool MyLD2410::runFrame(const byte *frame, const byte *readBack)
+{
+  if (inTransaction)
+  {
+    if (readBack == LD2410::param)
+      txnReadBack = true; // Read the parameters only once, at the end of the transaction
+    else if (readBack)
+      return batchFrame(frame) && batch(readBack);
+    return batchFrame(frame);
+  }
+  if (isConfig)
+    return sendFrame(frame) && (!readBack || sendCommand(readBack));
+  return configMode() && sendFrame(frame) && (!readBack || sendCommand(readBack)) && configMode(false);
+}
+
+bool MyLD2410::batch(const byte *command)
+{
+  byte frame[LD2410_MAX_FRAME];
+  return batchFrame(LD2410::load(frame, command));
+}
+
+bool MyLD2410::batchFrame(const byte *frame)
+{
+  if (frame[4] + 10 > LD2410_MAX_FRAME)
+    return false;
+  unsigned int h;
+  while (!(h = enqueue(frame, nullptr, true)))
+    pump(); // The queue is full, wait for a free slot
+  txnLast = h;
+  return true;
+}
+
+bool MyLD2410::beginTransaction()
+{
+  if (inTransaction)
+    return false;
+  inTransaction = true;
+  txnSuccess = true;
+  txnReadBack = false;
+  txnWasConfig = isConfig;
+  txnLast = 0;
+  return isConfig || batch(LD2410::configEnable);
+}
+
+bool MyLD2410::endTransaction()
+{
+  if (!inTransaction)
+    return false;
+  if (txnReadBack)
+    batch(LD2410::param);
+  if (!txnWasConfig)
+    batch(LD2410::configDisable);
+  inTransaction = false;
+  if (txnLast)
+  {
+    while (commandStatus(txnLast) < COMMAND_DONE)
+      pump();
+  }
+  return txnSuccess;
+}
+
 bool MyLD2410::configMode(bool enable)
 {
   if (enable && !isConfig)
@@ -422,104 +1328,99 @@ bool MyLD2410::configMode(bool enable)
 
 bool MyLD2410::enhancedMode(bool enable)
 {
-  if (isConfig)
-    return sendCommand(((enable) ? LD2410::engOn : LD2410::engOff));
-  else
-    return configMode() && sendCommand(((enable) ? LD2410::engOn : LD2410::engOff)) && configMode(false);
+  return run(((enable) ? LD2410::engOn : LD2410::engOff));
 }
 
 bool MyLD2410::requestMAC()
 {
-  if (isConfig)
-    return sendCommand(LD2410::MAC);
-  return configMode() && sendCommand(LD2410::MAC) && configMode(false);
+  return run(LD2410::MAC);
 }
 
 bool MyLD2410::requestFirmware()
 {
-  if (isConfig)
-    return sendCommand(LD2410::firmware);
-  return configMode() && sendCommand(LD2410::firmware) && configMode(false);
+  return run(LD2410::firmware);
 }
 
 bool MyLD2410::requestResolution()
 {
-  if (isConfig)
-    return sendCommand(LD2410::res);
-  return configMode() && sendCommand(LD2410::res) && configMode(false);
+  return run(LD2410::res);
 }
 
 bool MyLD2410::setResolution(bool fine)
 {
-  if (isConfig && sendCommand(((fine) ? LD2410::resFine : LD2410::resCoarse)))
-    return sendCommand(LD2410::res);
-  return configMode() && sendCommand(((fine) ? LD2410::resFine : LD2410::resCoarse)) && sendCommand(LD2410::res) && configMode(false);
+  return run(((fine) ? LD2410::resFine : LD2410::resCoarse), LD2410::res);
 }
 
 bool MyLD2410::requestParameters()
 {
-  if (isConfig)
-    return sendCommand(LD2410::param);
-  return configMode() && sendCommand(LD2410::param) && configMode(false);
+  return run(LD2410::param);
 }
 
 bool MyLD2410::setGateParameters(byte gate, byte movingThreshold, byte stationaryThreshold)
 {
-  if (movingThreshold > 100)
-    movingThreshold = 100;
-  if (stationaryThreshold > 100)
-    stationaryThreshold = 100;
-  byte *cmd = LD2410::gateParam;
-  if (gate > 8)
-  {
-    cmd[6] = 0xFF;
-    cmd[7] = 0xFF;
-  }
-  else
-  {
-    cmd[6] = gate;
-    cmd[7] = 0;
-  }
-  cmd[12] = movingThreshold;
-  cmd[18] = stationaryThreshold;
-  if (isConfig && sendCommand(cmd))
-    return sendCommand(LD2410::param);
-  return configMode() && sendCommand(cmd) && sendCommand(LD2410::param) && configMode(false);
+  byte frame[LD2410_MAX_FRAME];
+  return runFrame(LD2410::gateCommand(frame, gate, movingThreshold, stationaryThreshold), LD2410::param);
 }
 
 bool MyLD2410::setMaxGate(byte movingGate, byte staticGate, byte noOneWindow)
 {
-  if (movingGate > 8)
-    movingGate = 8;
-  if (staticGate > 8)
-    staticGate = 8;
-  byte *cmd = LD2410::maxGate;
-  cmd[6] = movingGate;
-  cmd[12] = staticGate;
-  cmd[18] = noOneWindow;
-  if (isConfig && sendCommand(cmd))
-    return sendCommand(LD2410::param);
-  return configMode() && sendCommand(cmd) && sendCommand(LD2410::param) && configMode(false);
+  byte frame[LD2410_MAX_FRAME];
+  return runFrame(LD2410::maxGateCommand(frame, movingGate, staticGate, noOneWindow), LD2410::param);
 }
 
 bool MyLD2410::setGateParameters(const ValuesArray &moving_thresholds, const ValuesArray &stationary_thresholds, byte noOneWindow)
 {
-  if (!isConfig)
-    configMode();
-  bool success = isConfig;
-  if (success)
+  // Pipeline all 10 commands in one config session, unless already part of a larger transaction
+  bool own = !inTransaction;
+  if (own && !beginTransaction())
+    return false;
+  for (byte i = 0; i < 9; i++)
+    setGateParameters(i, moving_thresholds.values[i], stationary_thresholds.values[i]);
+  setMaxGate(moving_thresholds.N, stationary_thresholds.N, noOneWindow);
+  // Inside a larger transaction, the commands have only been queued: endTransaction() has the result
+  return (own) ? endTransaction() : txnSuccess;
+}
+
+bool MyLD2410::syncGateParameters(const ValuesArray &moving_thresholds, const ValuesArray &stationary_thresholds, byte noOneWindow)
+{
+  // Inside a transaction the parameters cannot be queried first: without a cache, write the whole profile
+  bool cached = maxRange || (!inTransaction && requestParameters());
+  if (!cached && !inTransaction)
+    return false;
+  byte changed = 0;
+  bool sameValues = true;
+  for (byte i = 0; i < 9; i++)
+  {
+    byte m = LD2410::threshold(moving_thresholds.values[i]);
+    byte s = LD2410::threshold(stationary_thresholds.values[i]);
+    if (!cached || (m != movingThresholds.values[i]) || (s != stationaryThresholds.values[i]))
+      changed++;
+    if ((m != LD2410::threshold(moving_thresholds.values[0])) || (s != LD2410::threshold(stationary_thresholds.values[0])))
+      sameValues = false;
+  }
+  bool maxChanged = !cached || (moving_thresholds.N != movingThresholds.N) ||
+                    (stationary_thresholds.N != stationaryThresholds.N) || (noOneWindow != noOne_window);
+  if (!changed && !maxChanged)
+    return true;
+  bool own = !inTransaction;
+  if (own && !beginTransaction())
+    return false;
+  if ((changed > 1) && sameValues) // A uniform profile is a single "all gates" command
+    setGateParameters(0xFF, moving_thresholds.values[0], stationary_thresholds.values[0]);
+  else
   {
     for (byte i = 0; i < 9; i++)
     {
-      if (!setGateParameters(i, moving_thresholds.values[i], stationary_thresholds.values[i]))
-      {
-        success = false;
-        break;
-      }
-      delay(20);
+      byte m = LD2410::threshold(moving_thresholds.values[i]);
+      byte s = LD2410::threshold(stationary_thresholds.values[i]);
+      if (!cached || (m != movingThresholds.values[i]) || (s != stationaryThresholds.values[i]))
+        setGateParameters(i, m, s);
     }
   }
-  return success && setMaxGate(moving_thresholds.N, stationary_thresholds.N, noOneWindow) && configMode(false);
+  if (maxChanged)
+    setMaxGate(moving_thresholds.N, stationary_thresholds.N, noOneWindow);
+  // Inside a larger transaction, the commands have only been queued: endTransaction() has the result
+  return (own) ? endTransaction() : txnSuccess;
 }
 
 bool MyLD2410::setNoOneWindow(byte noOneWindow)
@@ -559,9 +1460,7 @@ bool MyLD2410::setMaxStationaryGate(byte stationaryGate)
 
 bool MyLD2410::requestReset()
 {
-  if (isConfig)
-    return sendCommand(LD2410::reset) && sendCommand(LD2410::param);
-  return configMode() && sendCommand(LD2410::reset) && sendCommand(LD2410::param) && configMode(false);
+  return run(LD2410::reset, LD2410::param);
 }
 
 bool MyLD2410::requestReboot()
@@ -573,34 +1472,27 @@ bool MyLD2410::requestReboot()
 
 bool MyLD2410::requestBTon()
 {
-  if (isConfig)
-    return sendCommand(LD2410::BTon);
-  return configMode() && sendCommand(LD2410::BTon) && configMode(false);
+  return run(LD2410::BTon);
 }
 
 bool MyLD2410::requestBToff()
 {
-  if (isConfig)
-    return sendCommand(LD2410::BToff);
-  return configMode() && sendCommand(LD2410::BToff) && configMode(false);
+  return run(LD2410::BToff);
 }
 
 bool MyLD2410::setBTpassword(const char *passwd)
 {
-  byte cmd[10];
-  for (unsigned int i = 0; i < 4; i++)
-    cmd[i] = LD2410::BTpasswd[i];
+  byte frame[sizeof(LD2410::BTpasswd)];
+  LD2410::load(frame, LD2410::BTpasswd);
 
   for (unsigned int i = 0; i < 6; i++)
   {
     if (i < strlen(passwd))
-      cmd[4 + i] = byte(passwd[i]);
+      frame[8 + i] = byte(passwd[i]);
     else
-      cmd[4 + i] = byte(' ');
+      frame[8 + i] = byte(' ');
   }
-  if (isConfig)
-    return sendCommand(cmd);
-  return configMode() && sendCommand(cmd) && configMode(false);
+  return runFrame(frame);
 }
 
 bool MyLD2410::setBTpassword(const String &passwd)
@@ -610,37 +1502,111 @@ bool MyLD2410::setBTpassword(const String &passwd)
 
 bool MyLD2410::resetBTpassword()
 {
-  if (isConfig)
-    return sendCommand(LD2410::BTpasswd);
-  return configMode() && sendCommand(LD2410::BTpasswd) && configMode(false);
+  return run(LD2410::BTpasswd);
 }
 
 bool MyLD2410::setBaud(byte baud)
 {
   if ((baud < 1) || (baud > 8))
     return false;
-  byte cmd[6];
-  memcpy(cmd, LD2410::changeBaud, 6);
-  cmd[4] = baud;
+  byte frame[sizeof(LD2410::changeBaud)];
+  LD2410::load(frame, LD2410::changeBaud);
+  frame[8] = baud;
+  if (!((isConfig || configMode()) && sendFrame(frame) && requestReboot()))
+    return false;
+  baudIndex = baud;
+  return true;
+}
+
+bool MyLD2410::listen(unsigned long window)
+{
+  // Start from a clean parser: the bytes received at the previous rate are garbage
+  while (sensor->available() > 0)
+    sensor->read();
+  rxI = rxN = 0;
+  core.reset();
+  unsigned long start = millis();
+  while (millis() - start < window)
+    if (check() != FAIL)
+      return true;
+  // No data frames: the sensor may be in config mode, try a command
+  unsigned long t = timeout;
+  timeout = window;
+  // Always send the command, even if config mode is cached: only a reply proves the rate.
+  // The sensor acknowledges configEnable in config mode too
+  bool wasConfig = isConfig;
+  bool found = sendCommand(LD2410::configEnable);
+  if (found && !wasConfig)
+    configMode(false);
+  timeout = t;
+  return found;
+}
+
+byte MyLD2410::detectBaud(BaudCallback reopen, unsigned long window)
+{
+  for (byte i = 0; i < 8; i++)
+  {
+    byte b = LD2410::baudScan[i];
+    reopen(LD2410::bauds[b]);
+    if (listen(window))
+    {
+      baudIndex = b;
+      return b;
+    }
+  }
+  reopen(LD2410_BAUD_RATE);
+  baudIndex = 0;
+  return 0;
+}
+
+byte MyLD2410::stepDownBaud(BaudCallback reopen, unsigned long window)
+{
+  if (!baudIndex && !detectBaud(reopen))
+    return 0;
   if (isConfig)
-    return sendCommand(cmd) && requestReboot();
-  return configMode() && sendCommand(cmd) && requestReboot();
+    configMode(false); // Data frames flow only outside config mode
+  // Measure on every frame: the change-only and the OUT-pin modes drop or skip most of them
+  bool changes = changesOnly;
+  int pin = outPin;
+  changesOnly = false;
+  outPin = -1;
+  unsigned long frames = 0, start = millis();
+  while (millis() - start < window)
+    if (check() == DATA)
+      frames++;
+  changesOnly = changes;
+  outPin = pin;
+  if (!frames)
+    return 0;
+  // An enhanced frame is 45 bytes, 10 bits per byte on the line
+  unsigned long need = 2 * frames * 45 * 10 * 1000 / window;
+  byte b = 1;
+  while ((b < baudIndex) && (LD2410::bauds[b] < need))
+    b++;
+  if (b >= baudIndex)
+    return baudIndex;
+  byte old = baudIndex;
+  if (!setBaud(b))
+    return 0;
+  reopen(LD2410::bauds[b]);
+  if (listen(timeout))
+    return b;
+  // The sensor did not come back at the new rate: look for it
+  baudIndex = old;
+  return detectBaud(reopen);
+}
+
+unsigned long MyLD2410::getBaudRate()
+{
+  return LD2410::bauds[baudIndex];
 }
 
 byte MyLD2410::getResolution()
 {
   if (fineRes >= 0)
     return ((fineRes == 1) ? 20 : 75);
-  if (isConfig)
-  {
-    if (sendCommand(LD2410::res))
-      return getResolution();
-  }
-  else
-  {
-    if (configMode() && sendCommand(LD2410::res) && configMode(false))
-      return getResolution();
-  }
+  if (!inTransaction && run(LD2410::res) && (fineRes >= 0))
+    return getResolution();
   return 0;
 }
 
@@ -3,6 +3,42 @@
 #include <Arduino.h>
 #define LD2410_BAUD_RATE 256000
 #define LD2410_BUFFER_SIZE 0x40
+/*
+  The #ifndef options below change the layout of MyLD2410 (sizeof and members).
+  Set them as global build flags (e.g. -DLD2410_STATS=1 in build_flags or compiler.cpp.extra_flags),
+  never with a #define in the sketch: the library's own translation units would not see it,
+  and the sketch and the library would disagree on the class layout.
+*/
+#ifndef LD2410_RX_CHUNK
+#define LD2410_RX_CHUNK 0x20
+#endif
+#ifndef LD2410_COMMAND_QUEUE
+#if defined(__AVR__)
+#define LD2410_COMMAND_QUEUE 4
+#else
+#define LD2410_COMMAND_QUEUE 8
+#endif
+#endif
+#define LD2410_MAX_FRAME 0x1E
+#ifndef LD2410_STATS
+#define LD2410_STATS 0 // build with -DLD2410_STATS=1 to enable getStats()
+#endif
+#define LD2410_HISTOGRAM_BINS 8
+#if LD2410_STATS
+#define LD2410_COUNT(expr) (expr)
+#else
+#define LD2410_COUNT(expr)
+#endif
+#ifndef LD2410_ZONES
+#define LD2410_ZONES 8 // the number of zones for setZone()
+#endif
+#ifndef LD2410_OUT_SLOTS
+#define LD2410_OUT_SLOTS 4 // the number of sensors that can watch their OUT pin at the same time
+#endif
+#ifndef LD2410_PACKED_TICK
+#define LD2410_PACKED_TICK 10 // [ms] the time resolution of PackedSensorData
+#endif
+#include "LD2410Core.h"
 
 class MyLD2410
 {
@@ -13,6 +49,59 @@ public:
     ACK,
     DATA
   };
+  enum Command
+  {
+    CMD_CONFIG_ON = 0,
+    CMD_CONFIG_OFF,
+    CMD_MAC,
+    CMD_FIRMWARE,
+    CMD_RESOLUTION,
+    CMD_RESOLUTION_FINE,
+    CMD_RESOLUTION_COARSE,
+    CMD_PARAMETERS,
+    CMD_ENHANCED_ON,
+    CMD_ENHANCED_OFF,
+    CMD_BT_ON,
+    CMD_BT_OFF,
+    CMD_BT_PASSWORD_RESET,
+    CMD_FACTORY_RESET,
+    CMD_REBOOT
+  };
+  enum CommandStatus
+  {
+    COMMAND_UNKNOWN = 0,
+    COMMAND_PENDING,
+    COMMAND_SENT,
+    COMMAND_DONE,
+    COMMAND_FAILED,
+    COMMAND_TIMEOUT
+  };
+  /**
+   * @brief Called when an enqueued command completes
+   * @param handle - the handle returned by enqueueCommand()
+   * @param command - the command word, e.g. 0x61
+   * @param status - COMMAND_DONE, COMMAND_FAILED or COMMAND_TIMEOUT
+   */
+  typedef void (*CommandCallback)(unsigned int handle, unsigned int command, CommandStatus status);
+  enum Event
+  {
+    EVENT_STATUS,     // the presence status changed
+    EVENT_BAND_ENTER, // the detected distance entered the band
+    EVENT_BAND_LEAVE, // the detected distance left the band
+    EVENT_STALE       // no data frame within the data lifespan
+  };
+  struct SensorData;
+  /**
+   * @brief Called from check() when something changed
+   * @param event - what changed
+   * @param data - the latest sensor data
+   */
+  typedef void (*EventCallback)(Event event, const SensorData &data);
+  /**
+   * @brief Reopens the sensor serial port at a new rate, for detectBaud() and stepDownBaud()
+   * e.g. [](unsigned long baud) { sensorSerial.end(); sensorSerial.begin(baud, SERIAL_8N1, RX_PIN, TX_PIN); }
+   */
+  typedef void (*BaudCallback)(unsigned long baud);
   struct ValuesArray
   {
     byte values[9];
@@ -52,9 +141,394 @@ public:
     ValuesArray mTargetSignals;
     ValuesArray sTargetSignals;
   };
+#if LD2410_STATS
+  /**
+   * @brief Driver statistics (only with LD2410_STATS=1).
+   * Histogram bin i counts the values below (base << i), the last bin counts the rest.
+   */
+  struct Stats
+  {
+    unsigned long framesParsed;   // frames that passed the tail check
+    unsigned long tailErrors;     // frames rejected by the tail check
+    unsigned long lengthErrors;   // frames rejected by the length check
+    unsigned long unknownFrames;  // data frames of unknown type
+    unsigned long ackTimeouts;    // commands that timed out waiting for an ACK
+    unsigned long bytesDiscarded; // bytes skipped while hunting for a header, rejected frames included
+    unsigned long checkTime[LD2410_HISTOGRAM_BINS];     // check() duration, base 16 us
+    unsigned long frameInterval[LD2410_HISTOGRAM_BINS]; // time between data frames, base 25 ms
+  };
+#endif
+  /**
+   * @brief A compact (30 bytes), fixed-width copy of SensorData, e.g. for History<N, PackedSensorData>.
+   * The timestamp is kept in LD2410_PACKED_TICK units, modulo 2^16
+   * (about 11 minutes with the default 10 ms), and is restored relative to the present time.
+   */
+  struct PackedSensorData
+  {
+    uint16_t timestamp;
+    uint16_t mTargetDistance;
+    uint16_t sTargetDistance;
+    uint16_t distance;
+    byte status;
+    byte gates; // moving N (high nibble), stationary N (low nibble)
+    byte mTargetSignal;
+    byte sTargetSignal;
+    byte mTargetSignals[9];
+    byte sTargetSignals[9];
+
+    PackedSensorData() = default;
+    PackedSensorData(const SensorData &data);
+    /**
+     * @brief Restore the full SensorData record
+     *
+     * @param data - the output
+     * @param now - the present time in [ms], must be within 2^16 ticks of the original timestamp
+     */
+    void unpack(SensorData &data, unsigned long now) const;
+    /**
+     * @brief Restore the full SensorData record, relative to millis()
+     */
+    SensorData unpack() const;
+  };
+  /**
+   * @brief A snapshot of the device identity and configuration (42 bytes, no padding),
+   * e.g. for EEPROM.put() or an NVS blob, see getDescriptor() and loadDescriptor()
+   */
+  struct DeviceDescriptor
+  {
+    uint16_t version;
+    uint16_t bufferSize;
+    byte MAC[6];
+    byte firmware[6]; // as received: minor, major, build (LSB first)
+    byte resolution;  // 1: fine (20 cm), 0: coarse (75 cm)
+    byte maxRange;
+    byte movingGates;
+    byte stationaryGates;
+    byte movingThresholds[9];
+    byte stationaryThresholds[9];
+    byte noOneWindow;
+    byte reserved;
+    uint16_t checksum;
+    /**
+     * @brief Check the checksum, e.g. after reading the descriptor back from storage
+     */
+    bool valid() const;
+  };
+  /**
+   * @brief A zero-copy view of the latest validated data frame.
+   * The fields are decoded on access, straight from the receive buffer.
+   * The view is valid until the next call to check() (or to any blocking request).
+   */
+  class FrameView
+  {
+    const byte *frame;
+
+  public:
+    FrameView(const byte *payload = nullptr) : frame(payload) {}
+    /**
+     * @brief Check whether the view points to a data frame
+     */
+    bool valid() const { return frame != nullptr; }
+    bool enhanced() const { return frame && (frame[0] == 1); }
+    byte status() const { return frame[2] & 3; }
+    unsigned int movingTargetDistance() const { return frame[3] | (frame[4] << 8); }
+    byte movingTargetSignal() const { return frame[5]; }
+    unsigned int stationaryTargetDistance() const { return frame[6] | (frame[7] << 8); }
+    byte stationaryTargetSignal() const { return frame[8]; }
+    unsigned int detectedDistance() const { return frame[9] | (frame[10] << 8); }
+    /**
+     * @brief Get the last moving gate (N) in enhanced mode, 0 in basic mode
+     */
+    byte movingGates() const { return (enhanced()) ? ((frame[11] <= 8) ? frame[11] : 8) : 0; }
+    /**
+     * @brief Get the last stationary gate (N) in enhanced mode, 0 in basic mode
+     */
+    byte stationaryGates() const { return (enhanced()) ? ((frame[12] <= 8) ? frame[12] : 8) : 0; }
+    /**
+     * @brief Get the raw moving signals [0 - movingGates()], enhanced mode only
+     */
+    const byte *movingSignals() const { return frame + 13; }
+    /**
+     * @brief Get the raw stationary signals [0 - stationaryGates()], enhanced mode only
+     */
+    const byte *stationarySignals() const { return frame + 14 + movingGates(); }
+    byte movingSignal(byte gate) const { return movingSignals()[gate]; }
+    byte stationarySignal(byte gate) const { return stationarySignals()[gate]; }
+    byte lightLevel() const
+    {
+      byte level = (enhanced()) ? stationarySignals()[stationaryGates() + 1] : 0;
+      return (level > 80) ? level : 0;
+    }
+    /**
+     * @brief Get the raw frame payload (without header, length and tail), e.g. for forwarding
+     */
+    const byte *raw() const { return frame; }
+  };
+
+  /**
+   * @brief A lock-free single-producer/single-consumer queue of SensorData records.
+   * The producer is receive() (UART callback task side), the consumer is check().
+   * Use SensorQueue<N> to allocate the storage.
+   */
+  class DataQueue
+  {
+    SensorData *buf;
+    byte capacity;
+    byte head = 0;
+    byte tail = 0;
+    unsigned long droppedFrames = 0;
+
+  public:
+    DataQueue(SensorData *buffer, byte size) : buf(buffer), capacity(size) {}
+    /**
+     * @brief Producer side: append a record
+     * @return false if the queue is full (the record is dropped)
+     */
+    bool push(const SensorData &data);
+    /**
+     * @brief Consumer side: remove the oldest record
+     * @return false if the queue is empty
+     */
+    bool pop(SensorData &data);
+    /**
+     * @brief Get the number of records dropped because the queue was full
+     */
+    unsigned long dropped() const { return droppedFrames; }
+  };
+  template <byte N>
+  class SensorQueue : public DataQueue
+  {
+    static_assert((N > 0) && (N < 255), "SensorQueue<N> needs 0 < N < 255");
+    SensorData storage[N + 1];
+
+  public:
+    SensorQueue() : DataQueue(storage, N + 1) {}
+  };
+  /**
+   * @brief The interface through which the driver reports every validated frame (data and ACK).
+   * It is called from the parser (check(), or receive() with an attached queue) and must not block.
+   */
+  class TraceSink
+  {
+  public:
+    /**
+     * @param payload - the frame payload, without header, length and tail
+     * @param size - the payload length
+     * @param type - MyLD2410::DATA or MyLD2410::ACK
+     * @param timestamp - millis() at reception
+     */
+    virtual void trace(const byte *payload, byte size, Response type, unsigned long timestamp) = 0;
+  };
+  struct TracedFrame
+  {
+    unsigned long timestamp;
+    Response type;
+    byte size;
+    byte payload[LD2410_BUFFER_SIZE - 4];
+  };
+  /**
+   * @brief A ring buffer of the latest N raw frames with their timestamps, e.g. for field capture
+   *
+   * @tparam N - the capacity
+   */
+  template <byte N>
+  class TraceBuffer : public TraceSink
+  {
+    TracedFrame buf[N];
+    unsigned long total = 0;
+
+  public:
+    void trace(const byte *payload, byte size, Response type, unsigned long timestamp) override
+    {
+      TracedFrame &f = buf[total % N];
+      f.timestamp = timestamp;
+      f.type = type;
+      f.size = (size <= sizeof(f.payload)) ? size : sizeof(f.payload);
+      memcpy(f.payload, payload, f.size);
+      total++;
+    }
+    /**
+     * @brief Get the number of stored frames
+     */
+    byte size() const { return (total < N) ? total : N; }
+    /**
+     * @brief Get the number of frames traced so far (including overwritten ones)
+     */
+    unsigned long count() const { return total; }
+    /**
+     * @brief Access a stored frame, 0 being the oldest
+     */
+    const TracedFrame &operator[](byte i) const { return buf[(total - size() + i) % N]; }
+    void clear() { total = 0; }
+  };
+  /**
+   * @brief Integer filtering of the per-gate signals and of the status, across frames.
+   * Applied to each data frame before it is recorded or reported, see attachFilter().
+   */
+  class SignalFilter
+  {
+    uint16_t ema[2][9];     // Q8.8
+    byte window[2][9][2];   // the two previous samples
+    byte alpha = 0;         // Q0.8, 0: no EMA
+    bool median = false;
+    byte hold = 0;          // frames a new status must persist
+    byte status = 0;
+    byte candidate = 0;
+    byte streak = 0;
+    byte primedN[2]{0xFF, 0xFF};
+    void filter(ValuesArray &signals, byte k);
+
+  public:
+    /**
+     * @param alpha - EMA weight of the new sample in 1/256, 0 disables the EMA (e.g. 64 ~ 0.25)
+     * @param median - take the median of the last 3 samples (before the EMA)
+     * @param hold - a new status is reported after it persists for this many frames, 0 disables
+     */
+    SignalFilter(byte alpha = 64, bool median = true, byte hold = 0) : alpha(alpha), median(median), hold(hold) {}
+    void setEMA(byte alpha) { this->alpha = alpha; }
+    void setMedian(bool enable) { median = enable; }
+    void setStatusHysteresis(byte frames) { hold = frames; }
+    /**
+     * @brief Forget the previous frames
+     */
+    void reset()
+    {
+      primedN[0] = primedN[1] = 0xFF;
+      streak = 0;
+    }
+    /**
+     * @brief Filter a frame in place
+     */
+    void apply(SensorData &data);
+  };
+  /**
+   * @brief The interface through which the driver records every decoded data frame
+   */
+  class DataHistory
+  {
+  public:
+    virtual void record(const SensorData &data) = 0;
+  };
+  /**
+   * @brief A fixed-capacity ring buffer of the latest N data frames (with their timestamps).
+   * Every frame gets a sequence number: 0, 1, 2...; the oldest frames are overwritten.
+   *
+   * @tparam N - the capacity
+   * @tparam Record - the stored type, SensorData by default (must be assignable from SensorData)
+   */
+  template <unsigned int N, typename Record = SensorData>
+  class History : public DataHistory
+  {
+    Record buf[N];
+    unsigned long total = 0;
+
+  public:
+    class Iterator
+    {
+      const History *h;
+      unsigned long seq;
+
+    public:
+      Iterator(const History *history, unsigned long sequence) : h(history), seq(sequence) {}
+      const Record &operator*() const { return h->buf[seq % N]; }
+      const Record *operator->() const { return &h->buf[seq % N]; }
+      Iterator &operator++()
+      {
+        seq++;
+        return *this;
+      }
+      bool operator!=(const Iterator &other) const { return seq != other.seq; }
+      /**
+       * @brief Get the sequence number of the current record
+       */
+      unsigned long sequence() const { return seq; }
+    };
+    struct Range
+    {
+      Iterator first, last;
+      Iterator begin() const { return first; }
+      Iterator end() const { return last; }
+    };
+
+    void record(const SensorData &data) override
+    {
+      buf[total % N] = data;
+      total++;
+    }
+    /**
+     * @brief Get the number of stored records
+     */
+    unsigned int size() const { return (total < N) ? total : N; }
+    unsigned int capacity() const { return N; }
+    /**
+     * @brief Get the sequence number that the next record will have (= the number of recorded frames)
+     */
+    unsigned long sequence() const { return total; }
+    /**
+     * @brief Get the sequence number of the oldest stored record
+     */
+    unsigned long oldest() const { return total - size(); }
+    /**
+     * @brief Access a stored record, 0 being the oldest
+     */
+    const Record &operator[](unsigned int i) const { return buf[(oldest() + i) % N]; }
+    /**
+     * @brief Get the most recent record; check size() first
+     */
+    const Record &latest() const { return buf[(total - 1) % N]; }
+    void clear() { total = 0; }
+    Iterator begin() const { return Iterator(this, oldest()); }
+    Iterator end() const { return Iterator(this, total); }
+    /**
+     * @brief Get the records with a sequence number >= seq, oldest first.
+     * Records that have been overwritten are skipped.
+     *
+     * @param seq - e.g. the value of sequence() at the previous read
+     */
+    Range since(unsigned long seq) const
+    {
+      if (seq < oldest())
+        seq = oldest();
+      if (seq > total)
+        seq = total;
+      return Range{Iterator(this, seq), end()};
+    }
+  };
 
 private:
+  struct PendingCommand
+  {
+    byte frame[LD2410_MAX_FRAME];
+    unsigned int handle;
+    volatile byte status;
+    bool batched;
+    CommandCallback callback;
+  };
+  PendingCommand cmdQueue[LD2410_COMMAND_QUEUE]{};
+  unsigned int cmdNew = 1;
+  unsigned int cmdNext = 1;
+  volatile unsigned int cmdInFlight = 0;
+  unsigned long cmdSentAt = 0;
+  bool inTransaction = false;
+  bool txnSuccess = true;
+  bool txnReadBack = false;
+  bool txnWasConfig = false;
+  unsigned int txnLast = 0;
   SensorData sData;
+  SensorData rxData;
+  DataQueue *rxQueue = nullptr;
+  DataHistory *history = nullptr;
+  SignalFilter *filter = nullptr;
+  TraceSink *traceSink = nullptr;
+  EventCallback eventCallback = nullptr;
+  unsigned long bandFrom = 0;
+  unsigned long bandTo = 0; // 0: no band
+  byte lastStatus = 0xFF;   // 0xFF: no valid data yet, or stale
+  bool inBand = false;
+#if LD2410_STATS
+  Stats stats{};
+  unsigned long lastDataAt = 0;
+#endif
   ValuesArray stationaryThresholds;
   ValuesArray movingThresholds;
   byte maxRange = 0;
@@ -63,24 +537,64 @@ private:
   unsigned long version = 0;
   unsigned long bufferSize = 0;
   byte MAC[6];
-  String MACstr = "";
-  String firmware = "";
+  char MACstr[18]{};  // "XX:XX:XX:XX:XX:XX"
+  char firmware[16]{}; // "V.XX.XXXXXXXX"
+  byte firmwareRaw[6]{};
   int fineRes = -1;
+  uint16_t movingOccupancy = 0;     // bit i: gate i above its moving threshold
+  uint16_t stationaryOccupancy = 0; // bit i: gate i above its stationary threshold
+  uint16_t zoneFrom[LD2410_ZONES]{};
+  uint16_t zoneTo[LD2410_ZONES]{};
+  uint16_t zoneMask[LD2410_ZONES]{};
   bool isEnhanced = false;
   bool isConfig = false;
   unsigned long timeout = 2000;
+  unsigned long wakeUpTime = 0;
+  byte baudIndex = 0; // 0: unknown
+  int outPin = -1; // the watched OUT pin, -1 if none
+  byte outSlot = 0;
+  unsigned long outInterval = 0;
+  unsigned long outAt = 0;
+  bool listening = true;
   unsigned long dataLifespan = 500;
-  byte inBuf[LD2410_BUFFER_SIZE];
-  byte inBufI = 0;
-  byte headBuf[4];
-  byte headBufI = 0;
+  LD2410Core::Parser<LD2410_BUFFER_SIZE> core{millis};
+  bool dataInBuf = false; // the last completed frame was a data frame
+  bool lazySignals = false;
+  bool changesOnly = false;
+  unsigned long heartbeat = 0;
+  unsigned long reportedAt = 0;
+  bool reportNext = true;
+  PackedSensorData reported{}; // the last reported frame as decoded, before any filter
+  unsigned int distanceDeadband = 0;
+  byte signalTolerance = 0;
+  byte rxBuf[LD2410_RX_CHUNK];
+  byte rxI = 0;
+  byte rxN = 0;
   Stream *sensor;
   bool _debug = false;
   bool isDataValid();
-  bool readFrame();
+  bool isSignificant(unsigned long now);
+  bool gateOpen();
+  bool listen(unsigned long window);
+  Response fetch();
+  Response parse();
+  bool fillRx();
   bool sendCommand(const byte *command);
+  bool sendFrame(const byte *frame);
+  unsigned int enqueue(const byte *frame, CommandCallback callback, bool batched);
+  void pump();
+  void serviceCommands();
+  void finishCommand(unsigned int handle, CommandStatus status);
+  bool run(const byte *command, const byte *readBack = nullptr);
+  bool runFrame(const byte *frame, const byte *readBack = nullptr);
+  bool batch(const byte *command);
+  bool batchFrame(const byte *frame);
   bool processAck();
   bool processData();
+  void onData();
+  void raiseEvents();
+  void updateOccupancy();
+  void updateZones();
 
 public:
   /**
@@ -98,19 +612,242 @@ public:
    */
   bool begin();
 
+  /**
+   * @brief A faster begin() for wake-ups: returns as soon as the first frame header arrives,
+   * without waiting for the rest of the frame (check() completes it), or after the timeout.
+   *
+   * The wait is a yield() loop: it does not sleep or block the task.
+   *
+   * @param pin - [-1] polls the stream; otherwise a pin that changes when the sensor talks,
+   * e.g. the UART RX pin or the OUT pin: the stream is not touched until the pin interrupt fires.
+   * The interrupt takes one of the LD2410_OUT_SLOTS slots for the duration of the call
+   * (per instance, so several sensors can wait at once); if none is free, the stream is polled
+   * @return true if a header arrived, see getWakeUpTime()
+   */
+  bool beginFast(int pin = -1);
+
+  /**
+   * @brief Get the time to the first header in the last beginFast()
+   *
+   * @return unsigned long - [us], 0 if no header arrived
+   */
+  unsigned long getWakeUpTime();
+
+  /**
+   * @brief Duty-cycled mode: check() parses the stream only after the OUT pin changes
+   * (presence appeared or vanished) or once per interval, and stops again after one data frame.
+   * In between, check() returns FAIL at once, so the MCU can sleep; the bytes that piled up
+   * in the UART are dropped when parsing resumes. Not used with an attached queue.
+   *
+   * The data stays valid for the data lifespan + the interval (or maxQuiet) after the last frame,
+   * so a dead or unplugged sensor is still reported stale.
+   *
+   * @param pin - the GPIO connected to the OUT pin, must support interrupts
+   * @param interval - [ms] also parse one data frame per interval, 0 for presence changes only
+   * @param maxQuiet - [ms] with interval 0, the longest time without a frame: one is parsed after it anyway
+   * @return false if LD2410_OUT_SLOTS sensors are already watching a pin (or waiting in beginFast())
+   */
+  bool watchOutPin(byte pin, unsigned long interval = 0, unsigned long maxQuiet = 60000);
+
+  /**
+   * @brief Leave the duty-cycled mode: check() parses every frame again
+   */
+  void unwatchOutPin();
+
+  /**
+   * @brief Read the presence from the OUT pin, without any UART traffic
+   *
+   * @return true if the OUT pin signals presence; false also when no pin is watched
+   */
+  bool outPinPresence();
+
+  /**
+   * @brief Check whether check() is parsing: always in the normal mode,
+   * between a wake-up and the next data frame in the duty-cycled mode
+   */
+  bool isListening();
+
   /**
    * @brief Call this function to gracefully close the sensor. Useful for entering sleep mode.
    */
   void end();
 
   /**
-    @brief Call this function in the main loop
+    @brief Call this function in the main loop.
+    It never waits for data: only the bytes already buffered by the stream are consumed,
+    and a partially received frame is resumed on the next call
     @return MyLD2410::DATA = (true) if the latest frame contained data
     @return MyLD2410::ACK  = (true) if the latest frame contained a reply to a command
     @return MyLD2410::FAIL = (false) if no useful info was processed
     */
   Response check();
 
+  /**
+   * @brief Attach a queue and switch to the callback-driven receive backend.
+   * From now on, frames are parsed by receive() and check() only pops the decoded records.
+   * getFrameView(), getLightLevel() and lazy signals are not available in this mode.
+   *
+   * @param queue - e.g. a global MyLD2410::SensorQueue<8>
+   */
+  void attachQueue(DataQueue &queue);
+
+  /**
+   * @brief Return to polled mode, where check() parses the stream itself
+   */
+  void detachQueue();
+
+  /**
+   * @brief Parse all buffered bytes and push the decoded data frames to the attached queue.
+   * Call it from a UART RX callback that runs in task context, e.g. Serial1.onReceive([]() { sensor.receive(); });
+   * on ESP32. It is not ISR-safe: it reads the Stream (which takes locks on ESP32) and processes
+   * the command replies (ACK) here too, with their callbacks and the trace sink.
+   */
+  void receive();
+
+  /**
+   * @brief Get the number of received bytes waiting to be parsed
+   * (buffered by the stream, or staged by the driver)
+   */
+  int available();
+
+  /**
+   * @brief Attach a trace sink: every validated frame is passed to it, without blocking the parser.
+   * Unlike the debug mode, this does not print and does not change the timing.
+   *
+   * @param sink - e.g. a global MyLD2410::TraceBuffer<16>, or your own TraceSink
+   */
+  void setTraceSink(TraceSink &sink);
+
+  /**
+   * @brief Stop tracing the frames
+   */
+  void clearTraceSink();
+
+  /**
+   * @brief Attach a history buffer: every data frame is recorded into it.
+   *
+   * @param history - e.g. a global MyLD2410::History<32>
+   */
+  void attachHistory(DataHistory &history);
+
+  /**
+   * @brief Stop recording the data frames
+   */
+  void detachHistory();
+
+  /**
+   * @brief Attach a signal filter: every data frame is filtered in place before it is
+   * recorded or reported, so getMovingSignals(), getStatus() etc. return the filtered values
+   *
+   * @param filter - e.g. a global MyLD2410::SignalFilter(64, true, 3)
+   */
+  void attachFilter(SignalFilter &filter);
+
+  /**
+   * @brief Stop filtering the data frames
+   */
+  void detachFilter();
+
+  /**
+   * @brief Register a callback for the presence events. It is called from check() only
+   * when the status changes, the distance crosses the band, or the data goes stale.
+   *
+   * @param callback - nullptr to unregister
+   */
+  void onEvent(EventCallback callback);
+
+  /**
+   * @brief Set the distance band for EVENT_BAND_ENTER / EVENT_BAND_LEAVE.
+   * A target is in the band when the detected distance is within [from, to].
+   *
+   * @param from - [cm]
+   * @param to - [cm], 0 disables the band events
+   */
+  void setDistanceBand(unsigned long from, unsigned long to);
+
+  /**
+   * @brief Check whether the detected target is within the distance band
+   */
+  bool inDistanceBand();
+
+#if LD2410_STATS
+  /**
+   * @brief Get the driver statistics (only with LD2410_STATS=1)
+   */
+  const Stats &getStats();
+
+  /**
+   * @brief Reset the driver statistics
+   */
+  void resetStats();
+#endif
+
+  // ASYNCHRONOUS COMMANDS
+
+  /**
+   * @brief Enqueue a command without waiting for the reply.
+   * Keep calling check(): it transmits the queued commands one at a time
+   * and matches each ACK against its command word.
+   * The sensor accepts most commands only in config mode - enqueue CMD_CONFIG_ON first, and CMD_CONFIG_OFF last.
+   *
+   * @param command - see MyLD2410::Command
+   * @param callback - optional, called on completion (from check(), or receive() for the ACK)
+   * @return unsigned int - a handle for commandStatus(), 0 if the queue is full
+   */
+  unsigned int enqueueCommand(Command command, CommandCallback callback = nullptr);
+
+  /**
+   * @brief Enqueue the thresholds of a gate (or all gates, when gate > 8)
+   *
+   * @return unsigned int - a handle for commandStatus(), 0 if the queue is full
+   */
+  unsigned int enqueueGateParameters(byte gate, byte movingThreshold, byte stationaryThreshold, CommandCallback callback = nullptr);
+
+  /**
+   * @brief Enqueue the maximum moving/stationary gates and the no-one window
+   *
+   * @return unsigned int - a handle for commandStatus(), 0 if the queue is full
+   */
+  unsigned int enqueueMaxGate(byte movingGate, byte stationaryGate, byte noOneWindow = 5, CommandCallback callback = nullptr);
+
+  /**
+   * @brief Get the status of an enqueued command
+   *
+   * @param handle - returned by one of the enqueue functions
+   * @return CommandStatus - COMMAND_UNKNOWN if the handle is invalid, or has been recycled
+   */
+  CommandStatus commandStatus(unsigned int handle);
+
+  /**
+   * @brief Check whether enqueued commands are still waiting to be sent or acknowledged
+   */
+  bool commandsPending();
+
+  // TRANSACTIONS
+
+  /**
+   * @brief Begin a configuration transaction.
+   * Until endTransaction(), the request and set functions only collect their commands:
+   * config mode is entered once, the commands are pipelined back-to-back,
+   * and the parameters are read back once at the end.
+   * The results are deferred: inside the transaction, the request and set functions return true
+   * once their commands are queued (false only if the transaction has already failed),
+   * and only endTransaction() reports whether they succeeded. The getters do not query the sensor
+   * inside a transaction: they return the cached values, which endTransaction() refreshes.
+   *
+   * @return true on success, false if a transaction is already open
+   */
+  bool beginTransaction();
+
+  /**
+   * @brief Close the transaction: read back the parameters (if any were changed),
+   * exit config mode and wait for all collected commands to complete.
+   * After the first failure, the remaining commands are skipped.
+   *
+   * @return true if every command in the transaction succeeded
+   */
+  bool endTransaction();
+
   // GETTERS
 
   /**
@@ -218,18 +955,18 @@ public:
   const byte *getMAC();
 
   /**
-   * @brief Get the Bluetooth MAC address as a String
+   * @brief Get the Bluetooth MAC address as a c-string
    *
-   * @return String
+   * @return const char* - formatted in place, no heap allocation
    */
-  String getMACstr();
+  const char *getMACstr();
 
   /**
-   * @brief Get the Firmware as a String
+   * @brief Get the Firmware as a c-string
    *
-   * @return String
+   * @return const char* - formatted in place, no heap allocation
    */
-  String getFirmware();
+  const char *getFirmware();
 
   /**
    * @brief Get the protocol version
@@ -245,6 +982,38 @@ public:
    */
   const SensorData &getSensorData();
 
+  /**
+   * @brief Get a zero-copy view of the latest data frame, valid until the next check()
+   *
+   * @return FrameView - check valid(): it is invalid if the latest frame was not a data frame
+   */
+  FrameView getFrameView();
+
+  /**
+   * @brief Stop copying the per-gate signals into SensorData.
+   * getMovingSignals()/getStationarySignals() are no longer updated: read the signals through getFrameView()
+   *
+   * @param lazy [true]/false
+   */
+  void setLazyDecoding(bool lazy = true);
+
+  /**
+   * @brief Report only the significant data frames through check().
+   * A frame is significant when the status changes, a distance moves by more than the deadband,
+   * a gate signal (enhanced mode, not lazy) moves by more than the tolerance, or the heartbeat expires.
+   * The other frames are dropped before decoding. The data stays valid for dataLifespan + heartbeat.
+   *
+   * @param heartbeat - report at least one frame per heartbeat [ms]
+   * @param deadband - distance deadband [cm]
+   * @param tolerance - gate signal tolerance
+   */
+  void reportChangesOnly(unsigned long heartbeat = 1000, unsigned int deadband = 10, byte tolerance = 5);
+
+  /**
+   * @brief Report every data frame through check() (default)
+   */
+  void reportAllFrames();
+
   /**
    * @brief Get the sensor resolution (gate-width) in [cm]
    *
@@ -252,6 +1021,82 @@ public:
    */
   byte getResolution();
 
+  /**
+   * @brief Take a snapshot of the device identity and configuration.
+   * Whatever is not cached yet is queried, in a single config-mode session.
+   *
+   * @param descriptor - the output, with its checksum
+   * @return true on success
+   */
+  bool getDescriptor(DeviceDescriptor &descriptor);
+
+  /**
+   * @brief Restore the cached MAC, firmware, version, buffer size, resolution and parameters
+   * from a stored descriptor, so the getters do not query the sensor after a warm boot.
+   *
+   * @param descriptor - e.g. read with EEPROM.get()
+   * @param verify - [true] first check that the live sensor has the same MAC (one short config-mode session),
+   * false trusts the descriptor (no traffic at all)
+   * @return false if the descriptor is corrupt or belongs to another sensor
+   */
+  bool loadDescriptor(const DeviceDescriptor &descriptor, bool verify = true);
+
+  // OCCUPANCY
+
+  /**
+   * @brief Get the gates whose moving signal is above the moving threshold (enhanced mode only).
+   * Needs the thresholds: call requestParameters() once, otherwise no gate is occupied.
+   *
+   * @return uint16_t - bit i is set when gate i is occupied
+   */
+  uint16_t getMovingOccupancy();
+
+  /**
+   * @brief Get the gates whose stationary signal is above the stationary threshold (enhanced mode only)
+   *
+   * @return uint16_t - bit i is set when gate i is occupied
+   */
+  uint16_t getStationaryOccupancy();
+
+  /**
+   * @brief Get the gates with a moving or a stationary target
+   */
+  uint16_t getOccupancy();
+
+  /**
+   * @brief Define a zone by distance. The zone covers every gate that overlaps [from, to),
+   * according to the resolution (20 or 75 cm per gate), and follows resolution changes.
+   * Use an enum of your own to name the zones.
+   *
+   * @param zone - 0 .. LD2410_ZONES - 1
+   * @param from - [cm]
+   * @param to - [cm]
+   * @return true on success
+   */
+  bool setZone(byte zone, unsigned int from, unsigned int to);
+
+  /**
+   * @brief Get the gates of a zone
+   *
+   * @return uint16_t - bit i is set when gate i belongs to the zone
+   */
+  uint16_t getZoneMask(byte zone);
+
+  /**
+   * @brief Check whether a zone has a moving or a stationary target
+   */
+  bool zoneOccupied(byte zone);
+
+  /**
+   * @brief Check whether a zone has a moving target
+   */
+  bool zoneMoving(byte zone);
+
+  /**
+   * @brief Check whether a zone has a stationary target
+   */
+  bool zoneStationary(byte zone);
+
   // parameters
 
   /**
@@ -364,10 +1209,26 @@ public:
    * @param moving_thresholds as a ValueArray
    * @param stationary_thresholds as a ValueArray
    * @param noOneWindow
-   * @return true on success
+   * @return true on success; inside a transaction, true if queued (see beginTransaction())
    */
   bool setGateParameters(const ValuesArray &moving_thresholds, const ValuesArray &stationary_thresholds, byte noOneWindow = 5);
 
+  /**
+   * @brief Bring the sensor to a target profile, sending only the commands that are needed.
+   * The profile is compared with the cached parameters (queried first, if necessary):
+   * only the gates whose thresholds differ are written, and the max gates/no-one window only if they differ.
+   * Nothing is sent if the sensor already matches the profile.
+   * Inside a transaction, the commands are only queued and the result comes from endTransaction();
+   * the parameters cannot be queried there, so without cached parameters the whole profile is written
+   * (call requestParameters() before the transaction to keep the diff).
+   *
+   * @param moving_thresholds as a ValueArray (all 9 gates, N = max moving gate)
+   * @param stationary_thresholds as a ValueArray (all 9 gates, N = max stationary gate)
+   * @param noOneWindow
+   * @return true on success; inside a transaction, true if queued
+   */
+  bool syncGateParameters(const ValuesArray &moving_thresholds, const ValuesArray &stationary_thresholds, byte noOneWindow = 5);
+
   /**
    * @brief Set the detection range for moving targets, stationary targets, as well as the no-one window
    *
@@ -464,6 +1325,35 @@ public:
    */
   bool setBaud(byte baud);
 
+  /**
+   * @brief Find the baud rate of the sensor. For each of the 8 rates of setBaud(), the port is reopened
+   * through the callback and the driver listens for a valid frame, then probes with a config-mode command.
+   *
+   * @param reopen - reopens the sensor serial port at a given rate
+   * @param window - [ms] the listening time per rate
+   * @return byte - the baud index (1 - 8) as in setBaud(), the port is left at that rate;
+   * 0 if not found, the port is left at LD2410_BAUD_RATE
+   */
+  byte detectBaud(BaudCallback reopen, unsigned long window = 250);
+
+  /**
+   * @brief Switch the sensor to the lowest baud rate that still carries enhanced-mode frames
+   * at the measured frame rate, with a 2x margin. The sensor reboots at the new rate.
+   * The change-only and the OUT-pin modes are suspended while measuring, so every frame counts.
+   *
+   * @param reopen - reopens the sensor serial port at a given rate
+   * @param window - [ms] the time to measure the frame rate
+   * @return byte - the new (or unchanged) baud index, 0 on failure
+   */
+  byte stepDownBaud(BaudCallback reopen, unsigned long window = 1000);
+
+  /**
+   * @brief Get the baud rate found by detectBaud() or set by setBaud()
+   *
+   * @return unsigned long - 0 if unknown
+   */
+  unsigned long getBaudRate();
+
   /**
    * @brief Get the Light Level
    *
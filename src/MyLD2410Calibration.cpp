@@ -0,0 +1,139 @@
+#include "MyLD2410Calibration.h"
+
+/*** BEGIN LD2410 namespace ***/
+namespace LD2410
+{
+  // The integer square root, rounded down
+  uint32_t isqrt(uint32_t x)
+  {
+    uint32_t root = 0, bit = 1UL << 30;
+    while (bit > x)
+      bit >>= 2;
+    while (bit)
+    {
+      if (x >= root + bit)
+      {
+        x -= root + bit;
+        root = (root >> 1) + bit;
+      }
+      else
+        root >>= 1;
+      bit >>= 2;
+    }
+    return root;
+  }
+}
+/*** END LD2410 namespace ***/
+
+MyLD2410Calibration::MyLD2410Calibration()
+{
+  reset();
+}
+
+void MyLD2410Calibration::reset()
+{
+  count = 0;
+  memset(gates, 0, sizeof(gates));
+  memset(sum, 0, sizeof(sum));
+  memset(sumSq, 0, sizeof(sumSq));
+  memset(peak, 0, sizeof(peak));
+}
+
+void MyLD2410Calibration::record(const MyLD2410::SensorData &data)
+{
+  if ((!data.mTargetSignals.N && !data.sTargetSignals.N) || (count == 0xFFFF))
+    return;
+  const MyLD2410::ValuesArray *signals[2]{&data.mTargetSignals, &data.sTargetSignals};
+  for (byte k = 0; k < 2; k++)
+  {
+    if (!signals[k]->N)
+      continue;
+    if (signals[k]->N >= gates[k])
+      gates[k] = signals[k]->N + 1;
+    for (byte i = 0; i <= signals[k]->N; i++)
+    {
+      byte v = signals[k]->values[i];
+      sum[k][i] += v;
+      sumSq[k][i] += uint16_t(v) * v;
+      if (v > peak[k][i])
+        peak[k][i] = v;
+    }
+  }
+  count++;
+}
+
+uint16_t MyLD2410Calibration::samples()
+{
+  return count;
+}
+
+uint16_t MyLD2410Calibration::mean(bool stationary, byte gate)
+{
+  if (!count || (gate > 8))
+    return 0;
+  return (sum[stationary][gate] << 8) / count;
+}
+
+uint16_t MyLD2410Calibration::deviation(bool stationary, byte gate)
+{
+  if (!count || (gate > 8))
+    return 0;
+  // n * sum(x^2) - sum(x)^2 = n^2 * variance; scaled by 2^16, its root is the deviation in 1/256 units
+  uint64_t s = sum[stationary][gate];
+  uint64_t v = ((uint64_t(count) * sumSq[stationary][gate] - s * s) << 16) / (uint32_t(count) * count);
+  return LD2410::isqrt(uint32_t(v));
+}
+
+byte MyLD2410Calibration::maximum(bool stationary, byte gate)
+{
+  return (gate <= 8) ? peak[stationary][gate] : 0;
+}
+
+byte MyLD2410Calibration::threshold(bool stationary, byte gate, byte k, byte margin)
+{
+  // Sum in 1/256 units, round up only at the end, so a deviation below 1 still counts
+  uint32_t t = ((mean(stationary, gate) + uint32_t(k) * deviation(stationary, gate) + 0xFF) >> 8) + margin;
+  uint32_t floor = maximum(stationary, gate) + margin;
+  if (t < floor)
+    t = floor;
+  return (t > 100) ? 100 : t;
+}
+
+bool MyLD2410Calibration::run(MyLD2410 &sensor, unsigned long window)
+{
+  // inBasicMode() only follows the mode commands: tell the mode from a frame the sensor sends now
+  unsigned long start = millis();
+  while (sensor.check() != MyLD2410::DATA)
+    if (millis() - start >= window)
+      return false;
+  const MyLD2410::SensorData &data = sensor.getSensorData();
+  bool basic = !data.mTargetSignals.N && !data.sTargetSignals.N;
+  if (basic && !sensor.enhancedMode())
+    return false;
+  reset();
+  sensor.attachHistory(*this);
+  start = millis();
+  while (millis() - start < window)
+    sensor.check();
+  sensor.detachHistory();
+  if (basic)
+    sensor.enhancedMode(false);
+  return count;
+}
+
+bool MyLD2410Calibration::apply(MyLD2410 &sensor, byte k, byte margin)
+{
+  if (!count)
+    return false;
+  // Start from the cached profile (all 9 gates), so the gates not recorded for a signal type stay as they are
+  const MyLD2410::ValuesArray &m = sensor.getMovingThresholds(), &s = sensor.getStationaryThresholds();
+  MyLD2410::ValuesArray moving, stationary;
+  moving.setN(m.N);
+  stationary.setN(s.N);
+  for (byte i = 0; i < 9; i++)
+  {
+    moving.values[i] = (i < gates[0]) ? threshold(false, i, k, margin) : m.values[i];
+    stationary.values[i] = (i < gates[1]) ? threshold(true, i, k, margin) : s.values[i];
+  }
+  return sensor.syncGateParameters(moving, stationary, sensor.getNoOneWindow());
+}
@@ -0,0 +1,85 @@
+#ifndef MY_LD2410_CALIBRATION_H
+#define MY_LD2410_CALIBRATION_H
+#include "MyLD2410.h"
+
+/**
+ * @brief Learns the per-gate noise floor of an empty room and derives the thresholds from it.
+ * It is a MyLD2410::DataHistory: run() attaches it for a time window in enhanced mode,
+ * or attach it yourself with attachHistory(). The statistics are integer sums,
+ * so up to 65535 frames (about 1.8 hours at 10 frames/s) can be accumulated.
+ */
+class MyLD2410Calibration : public MyLD2410::DataHistory
+{
+  uint16_t count = 0;
+  byte gates[2]{}; // the number of gates seen per signal type, 0 - none
+  uint32_t sum[2][9];
+  uint32_t sumSq[2][9];
+  byte peak[2][9];
+
+public:
+  MyLD2410Calibration();
+
+  /**
+   * @brief Forget the recorded frames
+   */
+  void reset();
+
+  /**
+   * @brief Accumulate the gate signals of an enhanced frame (basic frames are ignored)
+   */
+  void record(const MyLD2410::SensorData &data) override;
+
+  /**
+   * @brief Get the number of frames accumulated
+   */
+  uint16_t samples();
+
+  /**
+   * @brief Get the mean signal of a gate
+   *
+   * @param stationary - the stationary (true) or the moving (false) signal
+   * @param gate - 0 - 8
+   * @return uint16_t - the mean in 1/256 units
+   */
+  uint16_t mean(bool stationary, byte gate);
+
+  /**
+   * @brief Get the standard deviation of the signal of a gate
+   *
+   * @return uint16_t - the deviation in 1/256 units, rounded down
+   */
+  uint16_t deviation(bool stationary, byte gate);
+
+  /**
+   * @brief Get the highest signal of a gate
+   */
+  byte maximum(bool stationary, byte gate);
+
+  /**
+   * @brief Get the suggested threshold of a gate: mean + k * deviation, rounded up, + margin,
+   * at least maximum + margin, at most 100
+   */
+  byte threshold(bool stationary, byte gate, byte k = 3, byte margin = 5);
+
+  /**
+   * @brief Record an empty room: switch to enhanced mode if needed, accumulate for a window, restore the mode.
+   * The mode is told from the first data frame. Keep the room empty and lazy decoding off;
+   * any attached history is detached.
+   *
+   * @param sensor
+   * @param window - [ms]
+   * @return true if frames were recorded, false if no data frame arrived within the window
+   */
+  bool run(MyLD2410 &sensor, unsigned long window = 10000);
+
+  /**
+   * @brief Write the suggested thresholds to the sensor in one transaction, see MyLD2410::syncGateParameters().
+   * The max gates and the no-one window are kept, and so are the thresholds of the gates
+   * that no recorded frame reported for that signal type.
+   *
+   * @return true on success
+   */
+  bool apply(MyLD2410 &sensor, byte k = 3, byte margin = 5);
+};
+
+#endif // MY_LD2410_CALIBRATION_H
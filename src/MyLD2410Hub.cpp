@@ -0,0 +1,84 @@
+#include "MyLD2410Hub.h"
+
+MyLD2410Hub::MyLD2410Hub(Policy policy) : policy(policy) {}
+
+int MyLD2410Hub::add(MyLD2410 &sensor)
+{
+  if (count >= LD2410_HUB_SIZE)
+    return -1;
+  sensors[count] = &sensor;
+  return count++;
+}
+
+byte MyLD2410Hub::size()
+{
+  return count;
+}
+
+MyLD2410 &MyLD2410Hub::operator[](byte index)
+{
+  return *sensors[index];
+}
+
+int MyLD2410Hub::pick()
+{
+  if (policy == MOST_PENDING)
+  {
+    int best = -1, most = 0;
+    for (byte i = 0; i < count; i++)
+    {
+      int n = sensors[i]->available();
+      if (n > most)
+      {
+        most = n;
+        best = i;
+      }
+    }
+    return best;
+  }
+  for (byte k = 0; k < count; k++)
+  {
+    byte i = next;
+    next = (next + 1 < count) ? next + 1 : 0;
+    if (sensors[i]->available() > 0)
+      return i;
+  }
+  return -1;
+}
+
+uint32_t MyLD2410Hub::poll(unsigned long budget_us)
+{
+  unsigned long start = micros();
+  uint32_t fresh = 0;
+  // Keep the command pipelines moving, even for sensors without pending bytes
+  for (byte i = 0; i < count; i++)
+  {
+    if (sensors[i]->commandsPending() && (sensors[i]->check() == MyLD2410::DATA))
+      fresh |= 1UL << i;
+  }
+  do
+  {
+    int i = pick();
+    if (i < 0)
+      break;
+    if (sensors[i]->check() == MyLD2410::DATA)
+      fresh |= 1UL << i;
+  } while (micros() - start < budget_us);
+  frames |= fresh;
+  return fresh;
+}
+
+uint32_t MyLD2410Hub::newFrames()
+{
+  return frames;
+}
+
+bool MyLD2410Hub::hasNewFrame(byte index)
+{
+  return frames & (1UL << index);
+}
+
+void MyLD2410Hub::clearNewFrames(uint32_t mask)
+{
+  frames &= ~mask;
+}
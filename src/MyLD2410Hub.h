@@ -0,0 +1,80 @@
+#ifndef MY_LD2410_HUB_H
+#define MY_LD2410_HUB_H
+#include "MyLD2410.h"
+#ifndef LD2410_HUB_SIZE // changes the layout of MyLD2410Hub: set it as a global build flag, not in the sketch
+#define LD2410_HUB_SIZE 8 // at most 32
+#endif
+
+class MyLD2410Hub
+{
+public:
+  enum Policy
+  {
+    ROUND_ROBIN = 0,
+    MOST_PENDING
+  };
+
+private:
+  MyLD2410 *sensors[LD2410_HUB_SIZE];
+  byte count = 0;
+  byte next = 0;
+  Policy policy;
+  uint32_t frames = 0;
+  int pick();
+
+public:
+  /**
+   * @brief Construct a new MyLD2410Hub object
+   *
+   * @param policy - ROUND_ROBIN serves the sensors in turn,
+   * MOST_PENDING serves the sensor with the most bytes waiting first
+   */
+  MyLD2410Hub(Policy policy = ROUND_ROBIN);
+
+  /**
+   * @brief Add a sensor to the hub
+   *
+   * @param sensor
+   * @return int - the index of the sensor (its bit in the frame masks), -1 if the hub is full
+   */
+  int add(MyLD2410 &sensor);
+
+  /**
+   * @brief Get the number of sensors in the hub
+   */
+  byte size();
+
+  /**
+   * @brief Access a sensor by index
+   */
+  MyLD2410 &operator[](byte index);
+
+  /**
+   * @brief Call this function in the main loop instead of calling check() on each sensor.
+   * Serves the sensors one frame at a time according to the policy,
+   * until no sensor has pending bytes or the time budget is spent.
+   *
+   * @param budget_us - time budget in [us]; at least one frame is served
+   * @return uint32_t - bitmask of the sensors that received a data frame during this call
+   */
+  uint32_t poll(unsigned long budget_us = 1000);
+
+  /**
+   * @brief Get the bitmask of the sensors that received a data frame since the last clearNewFrames()
+   */
+  uint32_t newFrames();
+
+  /**
+   * @brief Check whether a sensor received a data frame since the last clearNewFrames()
+   */
+  bool hasNewFrame(byte index);
+
+  /**
+   * @brief Clear the "new frame" bits
+   *
+   * @param mask - the bits to clear, all by default
+   */
+  void clearNewFrames(uint32_t mask = 0xFFFFFFFF);
+};
+
+#endif // MY_LD2410_HUB_H
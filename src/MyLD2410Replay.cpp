@@ -0,0 +1,150 @@
+#include "MyLD2410Replay.h"
+
+/*** BEGIN LD2410 namespace ***/
+namespace LD2410
+{
+  const byte logMagic[4]{'L', 'D', '2', '4'};
+}
+/*** END LD2410 namespace ***/
+
+MyLD2410Recorder::MyLD2410Recorder(Print &log) : out(&log) {}
+
+void MyLD2410Recorder::writeVarint(unsigned long value)
+{
+  while (value >= 0x80)
+  {
+    out->write(byte(value | 0x80));
+    value >>= 7;
+  }
+  out->write(byte(value));
+}
+
+void MyLD2410Recorder::trace(const byte *payload, byte size, MyLD2410::Response type, unsigned long timestamp)
+{
+  if (!started)
+  {
+    out->write(LD2410::logMagic, sizeof(LD2410::logMagic));
+    out->write(byte(LD2410_LOG_VERSION));
+    last = timestamp;
+    started = true;
+  }
+  out->write(byte(type));
+  writeVarint(timestamp - last);
+  out->write(size);
+  if (out->write(payload, size) == size)
+    count++;
+  else
+    failed++;
+  last = timestamp;
+}
+
+unsigned long MyLD2410Recorder::records()
+{
+  return count;
+}
+
+unsigned long MyLD2410Recorder::errors()
+{
+  return failed;
+}
+
+MyLD2410Replay::MyLD2410Replay(Stream &log, unsigned int speed) : log(&log), speed(speed) {}
+
+void MyLD2410Replay::setSpeed(unsigned int speed)
+{
+  this->speed = speed;
+}
+
+bool MyLD2410Replay::readVarint(unsigned long &value)
+{
+  value = 0;
+  for (byte shift = 0; shift < 32; shift += 7)
+  {
+    int b = log->read();
+    if (b < 0)
+      return false;
+    value |= (unsigned long)(b & 0x7F) << shift;
+    if (!(b & 0x80))
+      return true;
+  }
+  return false;
+}
+
+bool MyLD2410Replay::load()
+{
+  if (broken || nextSize || (log->available() <= 0))
+    return nextSize;
+  if (!started)
+  {
+    byte head[sizeof(LD2410::logMagic) + 1];
+    if ((log->readBytes(head, sizeof(head)) != sizeof(head)) ||
+        memcmp(head, LD2410::logMagic, sizeof(LD2410::logMagic)) ||
+        (head[sizeof(LD2410::logMagic)] != LD2410_LOG_VERSION))
+    {
+      broken = true;
+      return false;
+    }
+    started = true;
+    startedAt = millis();
+  }
+  int type = log->read();
+  unsigned long delta;
+  int size = (readVarint(delta)) ? log->read() : -1;
+  if (((type != MyLD2410::ACK) && (type != MyLD2410::DATA)) || (size < 0) || (size > LD2410_BUFFER_SIZE - 4))
+  {
+    broken = true;
+    return false;
+  }
+  bool ack = (type == MyLD2410::ACK);
+  memcpy(frame, (ack) ? LD2410Core::headConfig : LD2410Core::headData, 4);
+  frame[4] = size;
+  frame[5] = 0;
+  if (log->readBytes(frame + 6, size) != size_t(size))
+  {
+    broken = true;
+    return false;
+  }
+  memcpy(frame + 6 + size, (ack) ? LD2410Core::tailConfig : LD2410Core::tailData, 4);
+  dueAt += delta;
+  nextSize = size + 10;
+  return true;
+}
+
+bool MyLD2410Replay::release()
+{
+  if (frameI < frameSize)
+    return true;
+  if (!load())
+    return false;
+  if (speed && ((millis() - startedAt) * speed < dueAt))
+    return false;
+  frameSize = nextSize;
+  frameI = 0;
+  nextSize = 0;
+  return true;
+}
+
+bool MyLD2410Replay::done()
+{
+  return (frameI >= frameSize) && !nextSize && (broken || (log->available() <= 0));
+}
+
+int MyLD2410Replay::available()
+{
+  return (release()) ? frameSize - frameI : 0;
+}
+
+int MyLD2410Replay::read()
+{
+  return (release()) ? frame[frameI++] : -1;
+}
+
+int MyLD2410Replay::peek()
+{
+  return (release()) ? frame[frameI] : -1;
+}
+
+size_t MyLD2410Replay::write(uint8_t)
+{
+  return 1;
+}
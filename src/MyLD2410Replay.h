@@ -0,0 +1,98 @@
+#ifndef MY_LD2410_REPLAY_H
+#define MY_LD2410_REPLAY_H
+#include "MyLD2410.h"
+
+/*
+  Log format: the magic "LD24" and a version byte, then one record per frame:
+  type (MyLD2410::ACK or MyLD2410::DATA), the time since the previous record
+  in [ms] as a varint (7 bits per byte, LSB first), the payload size and the payload.
+  A typical basic data frame takes 16 bytes.
+*/
+#define LD2410_LOG_VERSION 1
+
+/**
+ * @brief Writes every validated frame with its arrival time to a binary log.
+ * Pass it to MyLD2410::setTraceSink(). The log can be any Print, e.g. an SD card File.
+ * The frames are traced where they are parsed: when receive() runs from a UART callback,
+ * record from a MyLD2410::TraceBuffer in the main loop instead of writing to the card there.
+ */
+class MyLD2410Recorder : public MyLD2410::TraceSink
+{
+  Print *out;
+  unsigned long last = 0;
+  unsigned long count = 0;
+  unsigned long failed = 0;
+  bool started = false;
+
+  void writeVarint(unsigned long value);
+
+public:
+  /**
+   * @brief Construct a new MyLD2410Recorder object
+   *
+   * @param log - where the log is written
+   */
+  MyLD2410Recorder(Print &log);
+
+  void trace(const byte *payload, byte size, MyLD2410::Response type, unsigned long timestamp) override;
+
+  /**
+   * @brief Get the number of frames recorded
+   */
+  unsigned long records();
+
+  /**
+   * @brief Get the number of frames that could not be written completely
+   */
+  unsigned long errors();
+};
+
+/**
+ * @brief A Stream that feeds a recorded log back into MyLD2410,
+ * e.g. MyLD2410 sensor(replay); followed by the usual sensor.check() loop.
+ * Commands written to it are discarded, so only the recorded ACKs are seen.
+ */
+class MyLD2410Replay : public Stream
+{
+  Stream *log;
+  unsigned int speed;
+  byte frame[LD2410_BUFFER_SIZE + 6];
+  byte frameSize = 0;
+  byte frameI = 0;
+  byte nextSize = 0;  // a loaded frame waiting for its time, 0 if none
+  unsigned long dueAt = 0; // [ms] since the first record
+  unsigned long startedAt = 0;
+  bool started = false;
+  bool broken = false;
+
+  bool readVarint(unsigned long &value);
+  bool load();
+  bool release();
+
+public:
+  /**
+   * @brief Construct a new MyLD2410Replay object
+   *
+   * @param log - the recorded log, e.g. an SD card File opened for reading
+   * @param speed - 1 replays at the original speed, N replays N times faster,
+   * 0 replays as fast as the frames are read
+   */
+  MyLD2410Replay(Stream &log, unsigned int speed = 1);
+
+  /**
+   * @brief Change the replay speed
+   */
+  void setSpeed(unsigned int speed);
+
+  /**
+   * @brief Check whether the whole log has been replayed (or it is not a valid log)
+   */
+  bool done();
+
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t write(uint8_t) override;
+};
+
+#endif // MY_LD2410_REPLAY_H
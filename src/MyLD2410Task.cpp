@@ -0,0 +1,88 @@
+#include "MyLD2410Task.h"
+#if defined(ESP32)
+
+MyLD2410Task::MyLD2410Task(MyLD2410 &sensor) : sensor(&sensor) {}
+
+void MyLD2410Task::publish(const MyLD2410::SensorData &data)
+{
+  // Seqlock: the count is odd while writing, readers retry until they see the same even count twice
+  uint32_t s = __atomic_load_n(&seq, __ATOMIC_RELAXED);
+  __atomic_store_n(&seq, s + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  snapshot = data;
+  __atomic_store_n(&seq, s + 2, __ATOMIC_RELEASE);
+}
+
+void MyLD2410Task::loop(void *arg)
+{
+  MyLD2410Task *self = (MyLD2410Task *)arg;
+  while (self->running)
+  {
+    // Sleep until the UART callback notifies, or time out to service the command timeouts
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(50));
+    MyLD2410::Response response;
+    while ((response = self->sensor->check()) != MyLD2410::FAIL)
+      if (response == MyLD2410::DATA)
+        self->publish(self->sensor->getSensorData());
+  }
+  self->handle = nullptr;
+  vTaskDelete(nullptr);
+}
+
+bool MyLD2410Task::start(HardwareSerial &port, BaseType_t core, UBaseType_t priority)
+{
+  if (handle)
+    return false;
+  serial = &port;
+  running = true;
+  if (xTaskCreatePinnedToCore(loop, "LD2410", LD2410_TASK_STACK, this, priority, &handle, core) != pdPASS)
+  {
+    running = false;
+    handle = nullptr;
+    return false;
+  }
+  TaskHandle_t h = handle;
+  serial->onReceive([h]() { xTaskNotifyGive(h); });
+  return true;
+}
+
+void MyLD2410Task::stop()
+{
+  if (!handle)
+    return;
+  TaskHandle_t h = handle;
+  serial->onReceive(nullptr);
+  running = false;
+  xTaskNotifyGive(h);
+}
+
+bool MyLD2410Task::isRunning()
+{
+  return handle != nullptr;
+}
+
+uint32_t MyLD2410Task::read(MyLD2410::SensorData &data)
+{
+  uint32_t before, after;
+  for (;;)
+  {
+    before = __atomic_load_n(&seq, __ATOMIC_ACQUIRE);
+    if (!(before & 1))
+    {
+      data = snapshot;
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      after = __atomic_load_n(&seq, __ATOMIC_RELAXED);
+      if (before == after)
+        return before >> 1;
+    }
+    // Being written: block for a tick, so the writer runs even if it has a lower priority on this core
+    vTaskDelay(1);
+  }
+}
+
+uint32_t MyLD2410Task::sequence()
+{
+  return __atomic_load_n(&seq, __ATOMIC_ACQUIRE) >> 1;
+}
+
+#endif // ESP32
@@ -0,0 +1,76 @@
+#ifndef MY_LD2410_TASK_H
+#define MY_LD2410_TASK_H
+#include "MyLD2410.h"
+#if defined(ESP32)
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#ifndef LD2410_TASK_STACK
+#define LD2410_TASK_STACK 4096
+#endif
+
+/**
+ * @brief ESP32 only: a FreeRTOS task that owns a sensor. The task sleeps until the UART
+ * receives bytes (HardwareSerial::onReceive), parses them, and publishes every data frame
+ * as a snapshot that any task or core can read without tearing.
+ * While the task runs, only the task may call the sensor: use read() from the other tasks.
+ *
+ * The task waits on a notification from the Arduino onReceive() callback rather than on the
+ * ESP-IDF UART event queue, which HardwareSerial owns; it also wakes every 50 ms
+ * to service the command timeouts.
+ */
+class MyLD2410Task
+{
+  MyLD2410 *sensor;
+  HardwareSerial *serial = nullptr;
+  TaskHandle_t handle = nullptr;
+  volatile bool running = false;
+  uint32_t seq = 0; // odd while the snapshot is being written
+  MyLD2410::SensorData snapshot{};
+  static void loop(void *arg);
+  void publish(const MyLD2410::SensorData &data);
+
+public:
+  /**
+   * @brief Construct a new MyLD2410Task object
+   *
+   * @param sensor - the sensor, constructed on the HardwareSerial passed to start()
+   */
+  MyLD2410Task(MyLD2410 &sensor);
+
+  /**
+   * @brief Start the reader task
+   *
+   * @param port - the HardwareSerial of the sensor
+   * @param core - the core to pin the task to, tskNO_AFFINITY for any
+   * @param priority - the task priority
+   * @return true on success
+   */
+  bool start(HardwareSerial &port, BaseType_t core = tskNO_AFFINITY, UBaseType_t priority = 5);
+
+  /**
+   * @brief Stop the reader task (it exits after the frame it is parsing)
+   */
+  void stop();
+
+  /**
+   * @brief Check whether the task is running
+   */
+  bool isRunning();
+
+  /**
+   * @brief Copy the latest data frame, from any task or core.
+   * If the frame is being written, the reader blocks for a tick and retries (not from an ISR)
+   *
+   * @param data - the output
+   * @return uint32_t - the frame count, changes with every new frame; 0 if no frame arrived yet
+   */
+  uint32_t read(MyLD2410::SensorData &data);
+
+  /**
+   * @brief Get the frame count without copying the frame
+   */
+  uint32_t sequence();
+};
+
+#endif // ESP32
+#endif // MY_LD2410_TASK_H
@@ -0,0 +1,169 @@
+#include "MyLD2410Telemetry.h"
+
+/*** BEGIN LD2410 namespace ***/
+namespace LD2410
+{
+  byte *putVarint(byte *out, uint32_t value)
+  {
+    while (value >= 0x80)
+    {
+      *(out++) = byte(value | 0x80);
+      value >>= 7;
+    }
+    *(out++) = byte(value);
+    return out;
+  }
+  uint32_t zigzag(unsigned long value, unsigned long previous)
+  {
+    int32_t delta = int32_t(value - previous);
+    return (uint32_t(delta) << 1) ^ uint32_t(delta >> 31);
+  }
+  unsigned long unzigzag(uint32_t z, unsigned long previous)
+  {
+    return previous + long(int32_t((z >> 1) ^ (0 - (z & 1))));
+  }
+  byte quantize(byte signal)
+  {
+    return (((signal < 100) ? signal : 100) * 15 + 50) / 100;
+  }
+  byte dequantize(byte q)
+  {
+    return (q * 100 + 7) / 15;
+  }
+}
+/*** END LD2410 namespace ***/
+
+MyLD2410Encoder::MyLD2410Encoder(byte *buffer, size_t size) : buf(buffer), capacity(size) {}
+
+void MyLD2410Encoder::reset()
+{
+  used = 0;
+  lastTime = 0;
+  last[0] = last[1] = last[2] = 0;
+}
+
+bool MyLD2410Encoder::add(const MyLD2410::SensorData &data)
+{
+  // Encode on the side, copy only if the whole record fits
+  byte record[LD2410_RECORD_MAX];
+  byte *p = record;
+  bool enhanced = data.mTargetSignals.N || data.sTargetSignals.N;
+  *(p++) = (data.status & 3) | ((enhanced) ? 4 : 0);
+  p = LD2410::putVarint(p, data.timestamp - lastTime);
+  const unsigned long distances[3]{data.mTargetDistance, data.sTargetDistance, data.distance};
+  for (byte i = 0; i < 3; i++)
+    p = LD2410::putVarint(p, LD2410::zigzag(distances[i], last[i]));
+  *(p++) = data.mTargetSignal;
+  *(p++) = data.sTargetSignal;
+  if (enhanced)
+  {
+    *(p++) = (data.mTargetSignals.N << 4) | data.sTargetSignals.N;
+    byte nibbles = 0;
+    const MyLD2410::ValuesArray *signals[2]{&data.mTargetSignals, &data.sTargetSignals};
+    for (byte k = 0; k < 2; k++)
+      for (byte i = 0; i <= signals[k]->N; i++)
+      {
+        byte q = LD2410::quantize(signals[k]->values[i]);
+        if (nibbles++ & 1)
+          *(p - 1) |= q << 4;
+        else
+          *(p++) = q;
+      }
+  }
+  size_t n = p - record;
+  if (used + n > capacity)
+    return false;
+  memcpy(buf + used, record, n);
+  used += n;
+  lastTime = data.timestamp;
+  for (byte i = 0; i < 3; i++)
+    last[i] = distances[i];
+  return true;
+}
+
+bool MyLD2410Encoder::add(const MyLD2410::PackedSensorData &data)
+{
+  return add(data.unpack());
+}
+
+const byte *MyLD2410Encoder::data()
+{
+  return buf;
+}
+
+size_t MyLD2410Encoder::length()
+{
+  return used;
+}
+
+MyLD2410Decoder::MyLD2410Decoder(const byte *packet, size_t length) : buf(packet), size(length) {}
+
+bool MyLD2410Decoder::getByte(byte &value)
+{
+  if (pos >= size)
+    return false;
+  value = buf[pos++];
+  return true;
+}
+
+bool MyLD2410Decoder::getVarint(uint32_t &value)
+{
+  value = 0;
+  byte b;
+  for (byte shift = 0; shift < 35; shift += 7)
+  {
+    if (!getByte(b))
+      return false;
+    value |= uint32_t(b & 0x7F) << shift;
+    if (!(b & 0x80))
+      return true;
+  }
+  return false;
+}
+
+bool MyLD2410Decoder::next(MyLD2410::SensorData &data)
+{
+  byte flags;
+  uint32_t delta;
+  if (!getByte(flags) || (flags & 0xF8) || !getVarint(delta))
+    return false;
+  unsigned long distances[3];
+  for (byte i = 0; i < 3; i++)
+  {
+    uint32_t z;
+    if (!getVarint(z))
+      return false;
+    distances[i] = LD2410::unzigzag(z, last[i]);
+  }
+  if (!getByte(data.mTargetSignal) || !getByte(data.sTargetSignal))
+    return false;
+  data.mTargetSignals.setN(0);
+  data.sTargetSignals.setN(0);
+  data.mTargetSignals.values[0] = data.sTargetSignals.values[0] = 0;
+  if (flags & 4)
+  {
+    byte gates;
+    if (!getByte(gates) || ((gates >> 4) > 8) || ((gates & 0x0F) > 8))
+      return false;
+    data.mTargetSignals.setN(gates >> 4);
+    data.sTargetSignals.setN(gates & 0x0F);
+    byte nibbles = 0, b = 0;
+    MyLD2410::ValuesArray *signals[2]{&data.mTargetSignals, &data.sTargetSignals};
+    for (byte k = 0; k < 2; k++)
+      for (byte i = 0; i <= signals[k]->N; i++)
+      {
+        if (!(nibbles++ & 1) && !getByte(b))
+          return false;
+        signals[k]->values[i] = LD2410::dequantize((nibbles & 1) ? (b & 0x0F) : (b >> 4));
+      }
+  }
+  data.status = flags & 3;
+  lastTime += delta;
+  data.timestamp = lastTime;
+  data.mTargetDistance = distances[0];
+  data.sTargetDistance = distances[1];
+  data.distance = distances[2];
+  for (byte i = 0; i < 3; i++)
+    last[i] = distances[i];
+  return true;
+}
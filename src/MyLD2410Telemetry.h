@@ -0,0 +1,109 @@
+#ifndef MY_LD2410_TELEMETRY_H
+#define MY_LD2410_TELEMETRY_H
+#include "MyLD2410.h"
+
+/*
+  Packet format: a sequence of records, the first one absolute, the next ones relative to the previous.
+  Each record: a flags byte (status in bits 0-1, bit 2 set for enhanced data, the other bits 0),
+  the timestamp delta [ms] as a varint (7 bits per byte, LSB first), the moving, stationary
+  and detected distance deltas [cm] as zigzag varints, the moving and stationary signals (1 byte each),
+  and for enhanced data the gate counts (moving N in the high nibble) followed by the
+  moving then the stationary gate signals, quantized to 4 bits (0 - 15 for 0 - 100), two per byte.
+  A typical record takes 8 bytes in basic mode, 17 in enhanced mode.
+*/
+#define LD2410_RECORD_MAX 36 // the longest encoded record
+
+/**
+ * @brief Packs SensorData records into a caller-supplied buffer, e.g. an uplink payload
+ */
+class MyLD2410Encoder
+{
+  byte *buf;
+  size_t capacity;
+  size_t used = 0;
+  unsigned long lastTime = 0;
+  unsigned long last[3]{};
+
+public:
+  /**
+   * @brief Construct a new MyLD2410Encoder object
+   *
+   * @param buffer - receives the packet
+   * @param size - the size of the buffer
+   */
+  MyLD2410Encoder(byte *buffer, size_t size);
+
+  /**
+   * @brief Start a new packet
+   */
+  void reset();
+
+  /**
+   * @brief Append a record
+   *
+   * @return false if it does not fit (nothing is written)
+   */
+  bool add(const MyLD2410::SensorData &data);
+  bool add(const MyLD2410::PackedSensorData &data);
+
+  /**
+   * @brief Append the records of a history, oldest first, as long as they fit
+   *
+   * @param history - a MyLD2410::History of SensorData or PackedSensorData
+   * @param seq - the first sequence number to encode, e.g. the return value of the previous call
+   * @return unsigned long - the sequence number of the first record that was not encoded
+   */
+  template <unsigned int N, typename Record>
+  unsigned long addHistory(const MyLD2410::History<N, Record> &history, unsigned long seq)
+  {
+    typename MyLD2410::History<N, Record>::Range range = history.since(seq);
+    for (typename MyLD2410::History<N, Record>::Iterator i = range.begin(); i != range.end(); ++i)
+      if (!add(*i))
+        return i.sequence();
+    return history.sequence();
+  }
+
+  /**
+   * @brief Get the packet
+   */
+  const byte *data();
+
+  /**
+   * @brief Get the packet length in bytes
+   */
+  size_t length();
+};
+
+/**
+ * @brief Restores the SensorData records of a packet written by MyLD2410Encoder
+ */
+class MyLD2410Decoder
+{
+  const byte *buf;
+  size_t size;
+  size_t pos = 0;
+  unsigned long lastTime = 0;
+  unsigned long last[3]{};
+
+  bool getVarint(uint32_t &value);
+  bool getByte(byte &value);
+
+public:
+  /**
+   * @brief Construct a new MyLD2410Decoder object
+   *
+   * @param packet
+   * @param length - the packet length in bytes
+   */
+  MyLD2410Decoder(const byte *packet, size_t length);
+
+  /**
+   * @brief Decode the next record. The gate signals are restored from 4 bits (within about 4).
+   *
+   * @param data - the output
+   * @return false at the end of the packet, or if it is corrupt
+   */
+  bool next(MyLD2410::SensorData &data);
+};
+
+#endif // MY_LD2410_TELEMETRY_H